@@ -0,0 +1,269 @@
+#ifndef ARC_FLAGS_H_
+#define ARC_FLAGS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "dijkstra.h"
+#include "graph.h"
+
+const char kArcFlagFileMagic[4] = {'E', 'W', 'D', 'F'};
+const uint32_t kArcFlagFileVersion = 2;
+// One bit per region in the flag word of an edge
+const int kMaxRegions = 64;
+
+// Header of an arc flag file. It is followed by the region of every vertex
+// (numVertices x uint32) and the flags of every edge (numEdges x uint64,
+// in the order of Graph::GetEdges()), in host byte order. @checksum is
+// that of the graph it was built for (see Graph::Checksum()).
+struct ArcFlagFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t numVertices;
+  uint32_t numRegions;
+  uint64_t numEdges;
+  uint64_t checksum;
+};
+
+// Arc flags: the vertices are split into regions, and bit r of the flags
+// of an edge is set if the edge starts a shortest path to some vertex of
+// region r. A search towards t only needs the edges flagged for the region
+// of t, which prunes most of the graph away from the target.
+class ArcFlags {
+ public:
+  // Splits @g into @k regions (at most kMaxRegions) and flags every edge.
+  // Runs a backward Dijkstra from each vertex entered from outside its
+  // region. Needs the reverse adjacency of @g.
+  void Build(const Graph &g, int k);
+  int Save(const std::string &fileName) const;
+  // Returns -1 if the file is invalid or was built for another graph
+  int Load(const std::string &fileName, const Graph &g);
+
+  int GetNumRegions(void) const;
+  unsigned int GetRegion(unsigned int v) const;
+  // Flags of the out-edges of @u, in the order of Graph::GetEdges(u)
+  const uint64_t* GetFlags(unsigned int u) const;
+  // Share of the edge and region pairs that are flagged
+  double GetFlagDensity(void) const;
+
+ private:
+  // Regions grown breadth-first, over out- and in-edges, from seeds picked
+  // farthest first: every vertex joins the region of its nearest seed in
+  // hops. Vertices no seed reaches join the last region.
+  void Partition(const Graph &g, int k);
+  // Gives @v and the vertices it is closer to than their current seed to
+  // region @r
+  void GrowRegion(const Graph &g, unsigned int v, unsigned int r,
+                  std::vector<unsigned int> &hops);
+
+  int numVertices = 0;
+  int numRegions = 0;
+  std::vector<uint32_t> region;
+  // The flags of the edges of u start at flags[firstFlag[u]]
+  std::vector<uint64_t> firstFlag;
+  std::vector<uint64_t> flags;
+  uint64_t graphChecksum = 0;  // Of the graph built for
+};
+
+inline void ArcFlags::Build(const Graph &g, int k) {
+  numVertices = g.GetNumVertices();
+  graphChecksum = g.Checksum();
+  Partition(g, k);
+
+  firstFlag.assign(1, 0);
+  for (int u = 0; u < numVertices; u++)
+    firstFlag.push_back(firstFlag.back() + g.GetEdges(u).size());
+  flags.assign(firstFlag.back(), 0);
+
+  // Edges within a region lead to it
+  for (int u = 0; u < numVertices; u++) {
+    uint64_t *edgeFlags = flags.data() + firstFlag[u];
+    for (const Edge &e : g.GetEdges(u)) {
+      if (region[e.GetEdgeDest()] == region[u])
+        *edgeFlags |= uint64_t(1) << region[u];
+      edgeFlags++;
+    }
+  }
+
+  // A shortest path into a region last enters it at a boundary vertex b,
+  // after a shortest path to b. Every edge u -> v on a shortest path to b,
+  // d(u, b) == w + d(v, b), gets the flag of the region of b; keeping all
+  // of them, not one tree, leaves every tie open to the search.
+  DijkstraWorkspace ws(numVertices);
+  for (int b = 0; b < numVertices; b++) {
+    bool boundary = false;
+    for (const Edge &e : g.GetReverseEdges(b))
+      boundary = boundary || region[e.GetEdgeDest()] != region[b];
+    if (!boundary)
+      continue;
+
+    RunDijkstra(g, b, -1, true, ws);
+    uint64_t bit = uint64_t(1) << region[b];
+    for (int u = 0; u < numVertices; u++) {
+      double distU = ws.GetDist(u);
+      if (distU == std::numeric_limits<double>::max())
+        continue;
+
+      uint64_t *edgeFlags = flags.data() + firstFlag[u];
+      for (const Edge &e : g.GetEdges(u)) {
+        double distV = ws.GetDist(e.GetEdgeDest());
+        if (distV != std::numeric_limits<double>::max()
+            && distV + e.GetWeight() == distU)
+          *edgeFlags |= bit;
+        edgeFlags++;
+      }
+    }
+  }
+}
+
+inline void ArcFlags::Partition(const Graph &g, int k) {
+  numRegions = std::max(1, std::min({k, kMaxRegions, numVertices}));
+  region.assign(numVertices, numRegions - 1);
+  std::vector<unsigned int> hops(numVertices,
+                                 std::numeric_limits<unsigned int>::max());
+
+  // Each next seed is the vertex farthest from the seeds so far, so
+  // regions come out of similar extent. Unreached vertices count as
+  // farthest, so separate components get seeds of their own.
+  for (int r = 0; r < numRegions && numVertices > 0; r++) {
+    int seed = 0;
+    for (int v = 1; v < numVertices; v++) {
+      if (hops[v] > hops[seed])
+        seed = v;
+    }
+    GrowRegion(g, seed, r, hops);
+  }
+}
+
+inline void ArcFlags::GrowRegion(const Graph &g, unsigned int v,
+                                 unsigned int r,
+                                 std::vector<unsigned int> &hops) {
+  std::vector<unsigned int> queue(1, v);
+
+  hops[v] = 0;
+  region[v] = r;
+  for (size_t head = 0; head < queue.size(); head++) {
+    unsigned int u = queue[head];
+    for (int reverse = 0; reverse < 2; reverse++) {
+      EdgeRange edges = reverse ? g.GetReverseEdges(u) : g.GetEdges(u);
+      for (const Edge &e : edges) {
+        unsigned int w = e.GetEdgeDest();
+        if (hops[u] + 1 < hops[w]) {
+          hops[w] = hops[u] + 1;
+          region[w] = r;
+          queue.push_back(w);
+        }
+      }
+    }
+  }
+}
+
+inline int ArcFlags::Save(const std::string &fileName) const {
+  std::ofstream myfile(fileName, std::ios::binary | std::ios::trunc);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  ArcFlagFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kArcFlagFileMagic, sizeof(kArcFlagFileMagic));
+  header.version = kArcFlagFileVersion;
+  header.numVertices = numVertices;
+  header.numRegions = numRegions;
+  header.numEdges = flags.size();
+  header.checksum = graphChecksum;
+
+  myfile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  myfile.write(reinterpret_cast<const char *>(region.data()),
+               region.size() * sizeof(uint32_t));
+  myfile.write(reinterpret_cast<const char *>(flags.data()),
+               flags.size() * sizeof(uint64_t));
+
+  if (!myfile) {
+    std::cerr << "Error: cannot write file " << fileName << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+inline int ArcFlags::Load(const std::string &fileName, const Graph &g) {
+  std::ifstream myfile(fileName, std::ios::binary);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  ArcFlagFileHeader header;
+  if (!myfile.read(reinterpret_cast<char *>(&header), sizeof(header))
+      || std::memcmp(header.magic, kArcFlagFileMagic,
+                     sizeof(kArcFlagFileMagic)) != 0
+      || header.version != kArcFlagFileVersion
+      || header.numRegions < 1
+      || header.numRegions > static_cast<uint32_t>(kMaxRegions)) {
+    std::cerr << "Error: invalid arc flag file " << fileName << std::endl;
+    return -1;
+  }
+  if (header.numVertices != static_cast<uint32_t>(g.GetNumVertices())
+      || header.numEdges != static_cast<uint64_t>(g.GetNumEdges())
+      || header.checksum != g.Checksum()) {
+    std::cerr << "Error: arc flag file " << fileName
+              << " does not match the graph" << std::endl;
+    return -1;
+  }
+
+  numVertices = header.numVertices;
+  numRegions = header.numRegions;
+  region.resize(numVertices);
+  flags.resize(header.numEdges);
+  myfile.read(reinterpret_cast<char *>(region.data()),
+              region.size() * sizeof(uint32_t));
+  myfile.read(reinterpret_cast<char *>(flags.data()),
+              flags.size() * sizeof(uint64_t));
+
+  bool valid = static_cast<bool>(myfile);
+  for (int v = 0; valid && v < numVertices; v++)
+    valid = region[v] < header.numRegions;
+  if (!valid) {
+    std::cerr << "Error: invalid arc flag file " << fileName << std::endl;
+    return -1;
+  }
+
+  firstFlag.assign(1, 0);
+  for (int u = 0; u < numVertices; u++)
+    firstFlag.push_back(firstFlag.back() + g.GetEdges(u).size());
+  graphChecksum = header.checksum;
+  return 0;
+}
+
+inline int ArcFlags::GetNumRegions(void) const {
+  return numRegions;
+}
+
+inline unsigned int ArcFlags::GetRegion(unsigned int v) const {
+  return region[v];
+}
+
+inline const uint64_t* ArcFlags::GetFlags(unsigned int u) const {
+  return flags.data() + firstFlag[u];
+}
+
+inline double ArcFlags::GetFlagDensity(void) const {
+  uint64_t numSet = 0;
+
+  if (flags.empty())
+    return 0;
+  for (uint64_t f : flags)
+    numSet += __builtin_popcountll(f);
+  return static_cast<double>(numSet) / (flags.size() * numRegions);
+}
+
+#endif  // ARC_FLAGS_H_
@@ -0,0 +1,173 @@
+#ifndef BUCKET_QUEUE_H_
+#define BUCKET_QUEUE_H_
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Indexed monotone bucket queue (Dial) with the interface of IndexMinPQ.
+// Keys are grouped in buckets of @width over a circular array, covering
+// keys up to @maxSpread above the current minimum. Top() returns any item
+// of the lowest non-empty bucket, so Dijkstra stays exact as long as
+// @width is no larger than the smallest edge weight. No item of that
+// bucket can then improve another one. With integer weights and a width
+// of 1, this is Dial's algorithm. @maxSpread is the largest edge weight.
+template <typename K>
+class BucketQueue {
+ public:
+  // Constructor with max number of indexes, bucket width and key spread
+  BucketQueue(int capacity, K width, K maxSpread);
+  // Return number of items
+  unsigned int Size();
+  // Return top (ie index associated to a key of the lowest bucket)
+  unsigned int Top();
+  // Remove top
+  void Pop();
+  // Associates @key with index @idx
+  void Push(const K &key, unsigned int idx);
+  // Return whether @idx is a valid index
+  bool Contains(unsigned int idx);
+  // Change key associated to index @idx
+  void ChangeKey(const K &key, unsigned int idx);
+  // Remove all items, in time proportional to the number of buckets
+  // unless the queue is already empty
+  void Clear();
+
+ private:
+  unsigned int capacity;
+  unsigned int cur_size;
+  K width;
+  // Absolute number of the lowest bucket that may hold items
+  size_t cur_bucket;
+  // Bucket of each index (absolute), and position in it
+  std::vector<size_t> idx_to_bucket;
+  std::vector<unsigned int> idx_to_pos;
+  std::vector<bool> contained;
+  std::vector<std::vector<unsigned int>> buckets;
+
+  size_t BucketOf(const K &key) {
+    return static_cast<size_t>(key / width);
+  }
+  std::vector<unsigned int>& Slot(size_t bucket) {
+    return buckets[bucket % buckets.size()];
+  }
+  void Insert(const K &key, unsigned int idx);
+  void Remove(unsigned int idx);
+  // Moves cur_bucket up to the lowest non-empty bucket
+  void Advance();
+};
+
+template <typename K>
+BucketQueue<K>::BucketQueue(int capacity, K width, K maxSpread)
+    : capacity(capacity),
+      cur_size(0),
+      width(width),
+      cur_bucket(0),
+      idx_to_bucket(capacity),
+      idx_to_pos(capacity),
+      contained(capacity, false),
+      // One spare bucket for rounding in key / width
+      buckets(static_cast<size_t>(std::floor(maxSpread / width)) + 3) {}
+
+template <typename K>
+unsigned int BucketQueue<K>::Size() {
+  return cur_size;
+}
+
+template <typename K>
+void BucketQueue<K>::Insert(const K &key, unsigned int idx) {
+  size_t b = BucketOf(key);
+  if (b < cur_bucket || b - cur_bucket >= buckets.size())
+    throw std::runtime_error("Key out of the bucket range!");
+
+  std::vector<unsigned int> &bucket = Slot(b);
+  idx_to_bucket[idx] = b;
+  idx_to_pos[idx] = bucket.size();
+  bucket.push_back(idx);
+  contained[idx] = true;
+}
+
+template <typename K>
+void BucketQueue<K>::Remove(unsigned int idx) {
+  std::vector<unsigned int> &bucket = Slot(idx_to_bucket[idx]);
+  unsigned int moved = bucket.back();
+
+  bucket[idx_to_pos[idx]] = moved;
+  idx_to_pos[moved] = idx_to_pos[idx];
+  bucket.pop_back();
+  contained[idx] = false;
+}
+
+template <typename K>
+void BucketQueue<K>::Advance() {
+  while (Slot(cur_bucket).empty())
+    cur_bucket++;
+}
+
+template <typename K>
+unsigned int BucketQueue<K>::Top() {
+  if (!Size())
+    throw std::underflow_error("Priority queue underflow!");
+
+  Advance();
+  return Slot(cur_bucket).back();
+}
+
+template <typename K>
+void BucketQueue<K>::Pop() {
+  if (!Size())
+    throw std::underflow_error("Empty priority queue!");
+
+  Advance();
+  Remove(Slot(cur_bucket).back());
+  cur_size--;
+}
+
+template <typename K>
+void BucketQueue<K>::Push(const K &key, unsigned int idx) {
+  if (idx >= capacity)
+    throw std::overflow_error("Index invalid!");
+  if (Contains(idx))
+    throw std::runtime_error("Index already exists!");
+
+  // An empty queue can jump ahead to a key past its range
+  if (!Size() && BucketOf(key) >= cur_bucket + buckets.size())
+    cur_bucket = BucketOf(key);
+  Insert(key, idx);
+  cur_size++;
+}
+
+template <typename K>
+bool BucketQueue<K>::Contains(unsigned int idx) {
+  if (idx >= capacity)
+    throw std::overflow_error("Index invalid!");
+  return contained[idx];
+}
+
+template <typename K>
+void BucketQueue<K>::ChangeKey(const K &key, unsigned int idx) {
+  if (idx >= capacity)
+    throw std::overflow_error("Index invalid!");
+  if (!Contains(idx))
+    throw std::runtime_error("Index does not exist!");
+
+  Remove(idx);
+  Insert(key, idx);
+}
+
+template <typename K>
+void BucketQueue<K>::Clear() {
+  cur_bucket = 0;
+  if (!Size())
+    return;
+
+  for (std::vector<unsigned int> &bucket : buckets) {
+    for (unsigned int idx : bucket)
+      contained[idx] = false;
+    bucket.clear();
+  }
+  cur_size = 0;
+}
+
+#endif  // BUCKET_QUEUE_H_
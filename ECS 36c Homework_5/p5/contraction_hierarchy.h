@@ -0,0 +1,553 @@
+#ifndef CONTRACTION_HIERARCHY_H_
+#define CONTRACTION_HIERARCHY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "dijkstra.h"
+#include "graph.h"
+#include "index_min_pq.h"
+
+const char kHierarchyFileMagic[4] = {'E', 'W', 'D', 'C'};
+const uint32_t kHierarchyFileVersion = 2;
+
+// Header of a contraction hierarchy file. It is followed by the ranks
+// (numVertices x uint32), then the upward and downward CSR graphs, each as
+// offsets (numVertices + 1 x uint32) and numUp/numDown HierarchyEdge
+// records, in host byte order. @numEdges and @checksum are those of the
+// graph it was built for (see Graph::Checksum()).
+struct HierarchyFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t numVertices;
+  uint32_t numUp;
+  uint32_t numDown;
+  uint32_t numShortcuts;
+  uint64_t numEdges;
+  uint64_t checksum;
+};
+
+// Edge of the hierarchy. @middle is the vertex a shortcut bypasses, or -1
+// for an edge of the original graph.
+struct HierarchyEdge {
+  unsigned int target;
+  int middle;
+  double weight;
+};
+
+// Contraction hierarchy (CH) over a Graph. Preprocessing contracts the
+// vertices one by one in order of importance, adding a shortcut u -> w
+// whenever the only shortest path from u to w goes through the contracted
+// vertex. A query is then a bidirectional Dijkstra that only follows edges
+// towards higher ranked vertices: @up holds the edges u -> w with
+// rank(w) > rank(u) at u, @down the edges u -> w with rank(u) > rank(w)
+// reversed at w.
+class ContractionHierarchy {
+ public:
+  void Build(const Graph &g);
+  int Save(const std::string &fileName) const;
+  // Returns -1 if the file is invalid or was built for another graph
+  int Load(const std::string &fileName, const Graph &g);
+
+  int GetNumShortcuts(void) const;
+  // Distance from @s to @t, or infinity if there is no path. The vertices
+  // of the unpacked path are stored in @path from @t back to @s.
+  double Query(unsigned int s, unsigned int t, DijkstraWorkspace &fwd,
+               DijkstraWorkspace &bwd, std::vector<int> &path) const;
+
+ private:
+  // Max number of vertices a witness search settles before giving up (and
+  // adding a shortcut that may not be needed)
+  static const int kWitnessSettleLimit = 500;
+
+  // Adjacency kept while contracting, only between uncontracted vertices.
+  // @isTarget flags the out-neighbours of the vertex being evaluated.
+  struct ContractionGraph {
+    std::vector<std::vector<HierarchyEdge>> out, in;
+    std::vector<bool> isTarget;
+  };
+
+  // Shortcut @edge starting at @source
+  struct Shortcut {
+    unsigned int source;
+    HierarchyEdge edge;
+  };
+
+  static void AddOrImprove(std::vector<HierarchyEdge> &edges,
+                           unsigned int target, int middle, double weight);
+  static void RemoveTarget(std::vector<HierarchyEdge> &edges,
+                           unsigned int target);
+  // Fills @shortcuts with the shortcuts needed to contract @v
+  static void FindShortcuts(ContractionGraph &cg, unsigned int v,
+                            DijkstraWorkspace &ws,
+                            std::vector<Shortcut> &shortcuts);
+  // Removes @v from @cg and adds its @shortcuts
+  static void Contract(ContractionGraph &cg, unsigned int v,
+                       const std::vector<Shortcut> &shortcuts);
+  void BuildSearchGraph(const std::vector<std::vector<HierarchyEdge>> &lists,
+                        std::vector<unsigned int> &offsets,
+                        std::vector<HierarchyEdge> &edges);
+
+  // Relax the edges of the vertex at the top of @ws's queue and keep the
+  // best meeting point with the opposite search @other. @stall holds the
+  // edges into that vertex from higher ranked ones (see Query()).
+  void Expand(const std::vector<unsigned int> &offsets,
+              const std::vector<HierarchyEdge> &edges,
+              const std::vector<unsigned int> &stallOffsets,
+              const std::vector<HierarchyEdge> &stallEdges,
+              DijkstraWorkspace &ws, const DijkstraWorkspace &other,
+              double &best, int &meet) const;
+  // Whether the loaded arrays are consistent
+  bool IsValid(void) const;
+  const HierarchyEdge* FindEdge(unsigned int from, unsigned int to) const;
+  // Append the original vertices of edge @from -> @to after @from
+  void Unpack(unsigned int from, unsigned int to,
+              std::vector<int> &path) const;
+
+  int numVertices = 0;
+  int numShortcuts = 0;
+  std::vector<unsigned int> rank;
+  std::vector<unsigned int> upOffsets, downOffsets;
+  std::vector<HierarchyEdge> upEdges, downEdges;
+  uint64_t numGraphEdges = 0, graphChecksum = 0;  // Of the graph built for
+};
+
+inline void ContractionHierarchy::AddOrImprove(
+    std::vector<HierarchyEdge> &edges, unsigned int target, int middle,
+    double weight) {
+  for (HierarchyEdge &e : edges) {
+    if (e.target == target) {
+      if (weight < e.weight) {
+        e.middle = middle;
+        e.weight = weight;
+      }
+      return;
+    }
+  }
+  edges.push_back(HierarchyEdge{target, middle, weight});
+}
+
+inline void ContractionHierarchy::RemoveTarget(
+    std::vector<HierarchyEdge> &edges, unsigned int target) {
+  for (unsigned int i = 0; i < edges.size(); i++) {
+    if (edges[i].target == target) {
+      edges[i] = edges.back();
+      edges.pop_back();
+      return;
+    }
+  }
+}
+
+// For every in-neighbour u and out-neighbour w of @v, runs a bounded
+// Dijkstra from u that avoids @v (a witness search). If it cannot find a
+// path from u to w as short as u -> v -> w, a shortcut is needed. The
+// search stops once every w is settled, past the longest path via @v, or
+// after kWitnessSettleLimit vertices.
+inline void ContractionHierarchy::FindShortcuts(
+    ContractionGraph &cg, unsigned int v, DijkstraWorkspace &ws,
+    std::vector<Shortcut> &shortcuts) {
+  shortcuts.clear();
+  for (const HierarchyEdge &out : cg.out[v])
+    cg.isTarget[out.target] = true;
+
+  for (const HierarchyEdge &in : cg.in[v]) {
+    unsigned int u = in.target;
+    double maxDist = 0;
+    unsigned int targetsLeft = cg.out[v].size();
+    for (const HierarchyEdge &out : cg.out[v])
+      maxDist = std::max(maxDist, in.weight + out.weight);
+
+    IndexMinPQ<double> &Q = ws.GetQueue();
+    ws.NewQuery();
+    ws.Update(u, 0, -1);
+    Q.Push(0, u);
+    for (int settled = 0; Q.Size() && settled < kWitnessSettleLimit;
+         settled++) {
+      unsigned int x = Q.Top();
+      Q.Pop();
+      double distX = ws.GetDist(x);
+      if (distX > maxDist)
+        break;
+      if (cg.isTarget[x] && --targetsLeft == 0)
+        break;
+      for (const HierarchyEdge &e : cg.out[x]) {
+        double alt = distX + e.weight;
+        if (e.target == v || alt >= ws.GetDist(e.target))
+          continue;
+        ws.Update(e.target, alt, x);
+        if (Q.Contains(e.target))
+          Q.ChangeKey(alt, e.target);
+        else
+          Q.Push(alt, e.target);
+      }
+    }
+
+    for (const HierarchyEdge &out : cg.out[v]) {
+      if (out.target == u)
+        continue;
+      double viaV = in.weight + out.weight;
+      if (ws.GetDist(out.target) <= viaV)
+        continue;
+      Shortcut sc = {u, {out.target, static_cast<int>(v), viaV}};
+      shortcuts.push_back(sc);
+    }
+  }
+
+  for (const HierarchyEdge &out : cg.out[v])
+    cg.isTarget[out.target] = false;
+}
+
+inline void ContractionHierarchy::Contract(
+    ContractionGraph &cg, unsigned int v,
+    const std::vector<Shortcut> &shortcuts) {
+  for (const HierarchyEdge &out : cg.out[v])
+    RemoveTarget(cg.in[out.target], v);
+  for (const HierarchyEdge &in : cg.in[v])
+    RemoveTarget(cg.out[in.target], v);
+  for (const Shortcut &sc : shortcuts) {
+    const HierarchyEdge &e = sc.edge;
+    AddOrImprove(cg.out[sc.source], e.target, e.middle, e.weight);
+    AddOrImprove(cg.in[e.target], sc.source, e.middle, e.weight);
+  }
+}
+
+// Node ordering uses the edge difference (shortcuts added minus edges
+// removed) plus the number of already contracted neighbours, which spreads
+// the contraction evenly over the graph. Priorities are updated lazily:
+// the top vertex is re-evaluated and only contracted if it stays minimal.
+inline void ContractionHierarchy::Build(const Graph &g) {
+  numVertices = g.GetNumVertices();
+  numShortcuts = 0;
+  numGraphEdges = g.GetNumEdges();
+  graphChecksum = g.Checksum();
+  rank.assign(numVertices, 0);
+
+  ContractionGraph cg;
+  cg.out.resize(numVertices);
+  cg.in.resize(numVertices);
+  for (int u = 0; u < numVertices; u++) {
+    for (const Edge &e : g.GetEdges(u)) {
+      if (e.GetEdgeDest() == static_cast<unsigned int>(u))
+        continue;
+      AddOrImprove(cg.out[u], e.GetEdgeDest(), -1, e.GetWeight());
+      AddOrImprove(cg.in[e.GetEdgeDest()], u, -1, e.GetWeight());
+    }
+  }
+
+  cg.isTarget.assign(numVertices, false);
+
+  DijkstraWorkspace ws(numVertices);
+  std::vector<Shortcut> shortcuts;
+  std::vector<int> contractedNeighbours(numVertices, 0);
+  std::vector<double> priority(numVertices);
+  IndexMinPQ<double> order(numVertices);
+  for (int v = 0; v < numVertices; v++) {
+    FindShortcuts(cg, v, ws, shortcuts);
+    priority[v] = static_cast<double>(shortcuts.size())
+        - (cg.in[v].size() + cg.out[v].size());
+    order.Push(priority[v], v);
+  }
+
+  // Final edges of each vertex, recorded when it is contracted
+  std::vector<std::vector<HierarchyEdge>> up(numVertices), down(numVertices);
+  unsigned int nextRank = 0;
+  while (order.Size()) {
+    unsigned int v = order.Top();
+    order.Pop();
+
+    FindShortcuts(cg, v, ws, shortcuts);
+    double current = static_cast<double>(shortcuts.size())
+        - (cg.in[v].size() + cg.out[v].size()) + contractedNeighbours[v];
+    if (order.Size() && current > priority[order.Top()]) {
+      priority[v] = current;
+      order.Push(current, v);
+      continue;
+    }
+
+    rank[v] = nextRank++;
+    up[v] = cg.out[v];
+    down[v] = cg.in[v];
+    for (const HierarchyEdge &e : cg.out[v])
+      contractedNeighbours[e.target]++;
+    for (const HierarchyEdge &e : cg.in[v])
+      contractedNeighbours[e.target]++;
+    Contract(cg, v, shortcuts);
+    numShortcuts += shortcuts.size();
+  }
+
+  BuildSearchGraph(up, upOffsets, upEdges);
+  BuildSearchGraph(down, downOffsets, downEdges);
+}
+
+inline void ContractionHierarchy::BuildSearchGraph(
+    const std::vector<std::vector<HierarchyEdge>> &lists,
+    std::vector<unsigned int> &offsets, std::vector<HierarchyEdge> &edges) {
+  offsets.assign(numVertices + 1, 0);
+  edges.clear();
+  for (int v = 0; v < numVertices; v++) {
+    edges.insert(edges.end(), lists[v].begin(), lists[v].end());
+    offsets[v + 1] = edges.size();
+  }
+}
+
+inline int ContractionHierarchy::GetNumShortcuts(void) const {
+  return numShortcuts;
+}
+
+inline int ContractionHierarchy::Save(const std::string &fileName) const {
+  std::ofstream myfile(fileName, std::ios::binary | std::ios::trunc);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  HierarchyFileHeader header;
+  std::memcpy(header.magic, kHierarchyFileMagic, sizeof(kHierarchyFileMagic));
+  header.version = kHierarchyFileVersion;
+  header.numVertices = numVertices;
+  header.numUp = upEdges.size();
+  header.numDown = downEdges.size();
+  header.numShortcuts = numShortcuts;
+  header.numEdges = numGraphEdges;
+  header.checksum = graphChecksum;
+
+  myfile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  myfile.write(reinterpret_cast<const char *>(rank.data()),
+               rank.size() * sizeof(unsigned int));
+  myfile.write(reinterpret_cast<const char *>(upOffsets.data()),
+               upOffsets.size() * sizeof(unsigned int));
+  myfile.write(reinterpret_cast<const char *>(upEdges.data()),
+               upEdges.size() * sizeof(HierarchyEdge));
+  myfile.write(reinterpret_cast<const char *>(downOffsets.data()),
+               downOffsets.size() * sizeof(unsigned int));
+  myfile.write(reinterpret_cast<const char *>(downEdges.data()),
+               downEdges.size() * sizeof(HierarchyEdge));
+
+  if (!myfile) {
+    std::cerr << "Error: cannot write file " << fileName << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+inline int ContractionHierarchy::Load(const std::string &fileName,
+                                      const Graph &g) {
+  std::ifstream myfile(fileName, std::ios::binary);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  HierarchyFileHeader header;
+  if (!myfile.read(reinterpret_cast<char *>(&header), sizeof(header))
+      || std::memcmp(header.magic, kHierarchyFileMagic,
+                     sizeof(kHierarchyFileMagic)) != 0
+      || header.version != kHierarchyFileVersion) {
+    std::cerr << "Error: invalid hierarchy file " << fileName << std::endl;
+    return -1;
+  }
+  if (header.numVertices != static_cast<uint32_t>(g.GetNumVertices())
+      || header.numEdges != static_cast<uint64_t>(g.GetNumEdges())
+      || header.checksum != g.Checksum()) {
+    std::cerr << "Error: hierarchy file " << fileName
+              << " does not match the graph" << std::endl;
+    return -1;
+  }
+
+  numVertices = header.numVertices;
+  numShortcuts = header.numShortcuts;
+  rank.resize(numVertices);
+  upOffsets.resize(numVertices + 1);
+  upEdges.resize(header.numUp);
+  downOffsets.resize(numVertices + 1);
+  downEdges.resize(header.numDown);
+
+  myfile.read(reinterpret_cast<char *>(rank.data()),
+              rank.size() * sizeof(unsigned int));
+  myfile.read(reinterpret_cast<char *>(upOffsets.data()),
+              upOffsets.size() * sizeof(unsigned int));
+  myfile.read(reinterpret_cast<char *>(upEdges.data()),
+              upEdges.size() * sizeof(HierarchyEdge));
+  myfile.read(reinterpret_cast<char *>(downOffsets.data()),
+              downOffsets.size() * sizeof(unsigned int));
+  myfile.read(reinterpret_cast<char *>(downEdges.data()),
+              downEdges.size() * sizeof(HierarchyEdge));
+
+  if (!myfile || !IsValid()) {
+    std::cerr << "Error: invalid hierarchy file " << fileName << std::endl;
+    return -1;
+  }
+  numGraphEdges = header.numEdges;
+  graphChecksum = header.checksum;
+  return 0;
+}
+
+// Query() and Unpack() follow the offsets, targets and middles without
+// checks. Unpack() also recurses on the middle of a shortcut, so that has
+// to rank below both ends for it to stop.
+inline bool ContractionHierarchy::IsValid(void) const {
+  std::vector<bool> ranked(numVertices, false);
+  for (int v = 0; v < numVertices; v++) {
+    if (rank[v] >= static_cast<unsigned int>(numVertices) || ranked[rank[v]])
+      return false;
+    ranked[rank[v]] = true;
+  }
+
+  const std::vector<unsigned int> *offsets[2] = {&upOffsets, &downOffsets};
+  const std::vector<HierarchyEdge> *edges[2] = {&upEdges, &downEdges};
+  for (int side = 0; side < 2; side++) {
+    const std::vector<unsigned int> &o = *offsets[side];
+    if (o[0] != 0 || o[numVertices] != edges[side]->size())
+      return false;
+    for (int v = 0; v < numVertices; v++) {
+      if (o[v] > o[v + 1])
+        return false;
+      for (unsigned int i = o[v]; i < o[v + 1]; i++) {
+        const HierarchyEdge &e = (*edges[side])[i];
+        if (e.target >= static_cast<unsigned int>(numVertices))
+          return false;
+        if (e.middle != -1
+            && (e.middle < 0 || e.middle >= numVertices
+                || rank[e.middle] >= std::min(rank[v], rank[e.target])))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+inline void ContractionHierarchy::Expand(
+    const std::vector<unsigned int> &offsets,
+    const std::vector<HierarchyEdge> &edges,
+    const std::vector<unsigned int> &stallOffsets,
+    const std::vector<HierarchyEdge> &stallEdges, DijkstraWorkspace &ws,
+    const DijkstraWorkspace &other, double &best, int &meet) const {
+  IndexMinPQ<double> &Q = ws.GetQueue();
+  unsigned int u = Q.Top();
+  Q.Pop();
+  ws.CountSettled();
+
+  double distU = ws.GetDist(u);
+  for (unsigned int i = stallOffsets[u]; i < stallOffsets[u + 1]; i++) {
+    if (ws.GetDist(stallEdges[i].target) + stallEdges[i].weight < distU)
+      return;
+  }
+
+  for (unsigned int i = offsets[u]; i < offsets[u + 1]; i++) {
+    unsigned int v = edges[i].target;
+    double alt = distU + edges[i].weight;
+    if (alt < ws.GetDist(v)) {
+      ws.Update(v, alt, u);
+
+      if (Q.Contains(v))
+        Q.ChangeKey(alt, v);
+      else
+        Q.Push(alt, v);
+
+      double otherDist = other.GetDist(v);
+      if (otherDist != std::numeric_limits<double>::max()
+          && alt + otherDist < best) {
+        best = alt + otherDist;
+        meet = v;
+      }
+    }
+  }
+}
+
+// Unlike plain bidirectional Dijkstra, the two upward searches cannot stop
+// at the first meeting: each one runs until its queue minimum reaches the
+// best distance found so far. A settled vertex that a higher ranked vertex
+// reaches with a shorter distance is not on a shortest up-down path, so
+// its edges are not relaxed (stall-on-demand).
+inline double ContractionHierarchy::Query(unsigned int s, unsigned int t,
+                                          DijkstraWorkspace &fwd,
+                                          DijkstraWorkspace &bwd,
+                                          std::vector<int> &path) const {
+  IndexMinPQ<double> &Qf = fwd.GetQueue();
+  IndexMinPQ<double> &Qb = bwd.GetQueue();
+  double best = std::numeric_limits<double>::max();
+  int meet = -1;
+
+  fwd.NewQuery();
+  bwd.NewQuery();
+  fwd.Update(s, 0, -1);
+  bwd.Update(t, 0, -1);
+  Qf.Push(0, s);
+  Qb.Push(0, t);
+
+  if (s == t) {
+    best = 0;
+    meet = s;
+  }
+
+  for (;;) {
+    bool forward = Qf.Size() && fwd.GetDist(Qf.Top()) < best;
+    bool backward = Qb.Size() && bwd.GetDist(Qb.Top()) < best;
+    if (!forward && !backward)
+      break;
+
+    if (forward && (!backward
+                    || fwd.GetDist(Qf.Top()) <= bwd.GetDist(Qb.Top())))
+      Expand(upOffsets, upEdges, downOffsets, downEdges, fwd, bwd, best,
+             meet);
+    else
+      Expand(downOffsets, downEdges, upOffsets, upEdges, bwd, fwd, best,
+             meet);
+  }
+
+  // Collect the hierarchy path from s to t, then unpack its shortcuts
+  path.clear();
+  if (meet == -1)
+    return best;
+
+  std::vector<int> packed;
+  for (int u = meet; u != -1; u = fwd.GetPrev(u))
+    packed.push_back(u);
+  std::reverse(packed.begin(), packed.end());
+  for (int u = bwd.GetPrev(meet); u != -1; u = bwd.GetPrev(u))
+    packed.push_back(u);
+
+  std::vector<int> unpacked(1, packed.front());
+  for (unsigned int i = 0; i + 1 < packed.size(); i++)
+    Unpack(packed[i], packed[i + 1], unpacked);
+
+  path.assign(unpacked.rbegin(), unpacked.rend());
+  return best;
+}
+
+inline const HierarchyEdge* ContractionHierarchy::FindEdge(
+    unsigned int from, unsigned int to) const {
+  const std::vector<unsigned int> &offsets =
+      rank[from] < rank[to] ? upOffsets : downOffsets;
+  const std::vector<HierarchyEdge> &edges =
+      rank[from] < rank[to] ? upEdges : downEdges;
+  unsigned int owner = rank[from] < rank[to] ? from : to;
+  unsigned int target = rank[from] < rank[to] ? to : from;
+
+  for (unsigned int i = offsets[owner]; i < offsets[owner + 1]; i++) {
+    if (edges[i].target == target)
+      return &edges[i];
+  }
+  return nullptr;
+}
+
+inline void ContractionHierarchy::Unpack(unsigned int from, unsigned int to,
+                                         std::vector<int> &path) const {
+  const HierarchyEdge *e = FindEdge(from, to);
+  if (e && e->middle != -1) {
+    Unpack(from, e->middle, path);
+    Unpack(e->middle, to, path);
+  } else {
+    path.push_back(to);
+  }
+}
+
+#endif  // CONTRACTION_HIERARCHY_H_
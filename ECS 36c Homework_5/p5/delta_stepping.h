@@ -0,0 +1,324 @@
+#ifndef DELTA_STEPPING_H_
+#define DELTA_STEPPING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "graph.h"
+
+// Reusable barrier for a fixed number of threads
+class ThreadBarrier {
+ public:
+  explicit ThreadBarrier(int numThreads) : numThreads(numThreads) {}
+  void Wait(void);
+
+ private:
+  std::mutex lock;
+  std::condition_variable cv;
+  int numThreads;
+  int waiting = 0;
+  unsigned int generation = 0;
+};
+
+// Parallel single-source shortest paths by delta-stepping (Meyer and
+// Sanders). Vertices are kept in buckets of width @delta by tentative
+// distance. The lowest bucket is emptied by repeatedly relaxing the light
+// edges (weight <= delta) of its vertices in parallel, then the heavy edges
+// of every vertex it held are relaxed once. Distances are updated with an
+// atomic compare-and-swap minimum. Tentative distances are never more than
+// the heaviest edge past the current bucket, so the buckets are a cyclic
+// array of NumBuckets() entries rather than one per @delta of distance.
+class DeltaStepping {
+ public:
+  DeltaStepping(const Graph &g, double delta, int numThreads);
+
+  // Computes the distances from @source to every vertex and a shortest
+  // path tree
+  void Run(unsigned int source);
+  double GetDist(unsigned int v) const;
+  int GetPrev(unsigned int v) const;
+  // Vertices taken out of a bucket by all runs so far, counting a vertex
+  // again for each bucket it is taken out of
+  uint64_t GetNumSettled(void) const;
+
+  // Average edge weight, a reasonable delta when none is given
+  static double DefaultDelta(const Graph &g);
+  // Buckets a search of @g with @delta cycles through
+  static double NumBuckets(const Graph &g, double delta);
+  // Returns -1 if @delta needs more than kMaxBuckets buckets on @g,
+  // 0 otherwise
+  static int CheckDelta(const Graph &g, double delta);
+
+  static const size_t kMaxBuckets = 1 << 24;
+
+ private:
+  enum Phase { kLight, kHeavy, kDone };
+
+  void Worker(int t);
+  // Atomic dist[v] = min(dist[v], alt); true if dist[v] was lowered
+  bool RelaxMin(unsigned int v, double alt);
+  // Files the vertices touched by the last step into their buckets and
+  // picks the next frontier; only run by thread 0
+  void NextFrontier(void);
+  void BuildTree(unsigned int source);
+  // Bucket of the tentative distance of @v, counted from 0 without
+  // wrapping around
+  uint64_t BucketOf(unsigned int v) const;
+  // Moves to a fresh stamp value, so no entry of @stamps matches @cur
+  static void NewStamp(std::vector<unsigned int> &stamps, unsigned int &cur);
+
+  const Graph &g;
+  double delta;
+  int numThreads;
+  ThreadBarrier barrier;
+
+  std::unique_ptr<std::atomic<double>[]> dist;
+  std::vector<int> prev;
+
+  // Bucket b is buckets[b % buckets.size()]
+  std::vector<std::vector<unsigned int>> buckets;
+  uint64_t curBucket = 0;
+  size_t numFiled = 0;  // Entries in all buckets, stale ones included
+  // Vertices the threads work on during the current step
+  std::vector<unsigned int> frontier;
+  // Vertices removed from the current bucket, for the heavy phase
+  std::vector<unsigned int> settled;
+  std::vector<unsigned int> frontierStamp, settledStamp;
+  unsigned int curFrontier = 0, curSettled = 0;
+  uint64_t numSettled = 0;
+  Phase phase = kLight;
+  // Vertices whose distance each thread lowered during the current step
+  std::vector<std::vector<unsigned int>> touched;
+};
+
+inline void ThreadBarrier::Wait(void) {
+  std::unique_lock<std::mutex> guard(lock);
+  unsigned int gen = generation;
+
+  if (++waiting == numThreads) {
+    waiting = 0;
+    generation++;
+    cv.notify_all();
+    return;
+  }
+  cv.wait(guard, [this, gen] { return gen != generation; });
+}
+
+inline DeltaStepping::DeltaStepping(const Graph &g, double delta,
+                                    int numThreads)
+    : g(g), delta(delta), numThreads(numThreads), barrier(numThreads),
+      dist(new std::atomic<double>[g.GetNumVertices()]),
+      prev(g.GetNumVertices()),
+      buckets(static_cast<size_t>(NumBuckets(g, delta))),
+      frontierStamp(g.GetNumVertices(), 0),
+      settledStamp(g.GetNumVertices(), 0),
+      touched(numThreads) {}
+
+inline double DeltaStepping::DefaultDelta(const Graph &g) {
+  double total = 0;
+  for (int u = 0; u < g.GetNumVertices(); u++) {
+    for (const Edge &e : g.GetEdges(u))
+      total += e.GetWeight();
+  }
+  if (g.GetNumEdges() == 0 || total == 0)
+    return 1;
+  return total / g.GetNumEdges();
+}
+
+// While bucket b is emptied, its vertices are below (b + 1) * delta, so
+// the distances they reach are below that plus the heaviest edge. One more
+// bucket covers the rounding of the divisions.
+inline double DeltaStepping::NumBuckets(const Graph &g, double delta) {
+  double maxWeight = 0;
+  for (int u = 0; u < g.GetNumVertices(); u++) {
+    for (const Edge &e : g.GetEdges(u))
+      maxWeight = std::max(maxWeight, e.GetWeight());
+  }
+  return std::ceil(maxWeight / delta) + 3;
+}
+
+inline int DeltaStepping::CheckDelta(const Graph &g, double delta) {
+  if (!(NumBuckets(g, delta) <= kMaxBuckets)) {
+    std::cerr << "Error: --delta " << delta << " is too small for the edge"
+              << " weights, which need more than " << kMaxBuckets
+              << " buckets" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+inline double DeltaStepping::GetDist(unsigned int v) const {
+  return dist[v].load(std::memory_order_relaxed);
+}
+
+inline int DeltaStepping::GetPrev(unsigned int v) const {
+  return prev[v];
+}
+
+inline uint64_t DeltaStepping::GetNumSettled(void) const {
+  return numSettled;
+}
+
+inline bool DeltaStepping::RelaxMin(unsigned int v, double alt) {
+  double cur = dist[v].load(std::memory_order_relaxed);
+  while (alt < cur) {
+    if (dist[v].compare_exchange_weak(cur, alt, std::memory_order_relaxed))
+      return true;
+  }
+  return false;
+}
+
+inline void DeltaStepping::Run(unsigned int source) {
+  for (int v = 0; v < g.GetNumVertices(); v++)
+    dist[v].store(std::numeric_limits<double>::max(),
+                  std::memory_order_relaxed);
+  for (std::vector<unsigned int> &bucket : buckets)
+    bucket.clear();
+  curBucket = 0;
+  numFiled = 0;
+  settled.clear();
+  NewStamp(settledStamp, curSettled);
+  phase = kLight;
+
+  dist[source].store(0, std::memory_order_relaxed);
+  touched[0].assign(1, source);
+  NextFrontier();
+
+  std::vector<std::thread> threads;
+  for (int t = 1; t < numThreads; t++)
+    threads.push_back(std::thread(&DeltaStepping::Worker, this, t));
+  Worker(0);
+  for (std::thread &t : threads)
+    t.join();
+
+  BuildTree(source);
+}
+
+// Each step, every thread relaxes its share of the frontier, then thread 0
+// prepares the next step while the others wait
+inline void DeltaStepping::Worker(int t) {
+  for (;;) {
+    if (phase == kDone)
+      return;
+
+    size_t first = frontier.size() * t / numThreads;
+    size_t last = frontier.size() * (t + 1) / numThreads;
+    bool light = phase == kLight;
+    for (size_t i = first; i < last; i++) {
+      unsigned int u = frontier[i];
+      double distU = dist[u].load(std::memory_order_relaxed);
+      for (const Edge &e : g.GetEdges(u)) {
+        if ((e.GetWeight() <= delta) != light)
+          continue;
+        if (RelaxMin(e.GetEdgeDest(), distU + e.GetWeight()))
+          touched[t].push_back(e.GetEdgeDest());
+      }
+    }
+
+    barrier.Wait();
+    if (t == 0)
+      NextFrontier();
+    barrier.Wait();
+  }
+}
+
+inline void DeltaStepping::NextFrontier(void) {
+  for (std::vector<unsigned int> &list : touched) {
+    for (unsigned int v : list)
+      buckets[BucketOf(v) % buckets.size()].push_back(v);
+    numFiled += list.size();
+    list.clear();
+  }
+
+  for (;;) {
+    // Light edges again while the current bucket refills
+    std::vector<unsigned int> &bucket = buckets[curBucket % buckets.size()];
+    NewStamp(frontierStamp, curFrontier);
+    frontier.clear();
+    for (unsigned int v : bucket) {
+      if (BucketOf(v) != curBucket || frontierStamp[v] == curFrontier)
+        continue;  // Stale entry or duplicate
+      frontierStamp[v] = curFrontier;
+      frontier.push_back(v);
+      if (settledStamp[v] != curSettled) {
+        settledStamp[v] = curSettled;
+        settled.push_back(v);
+        numSettled++;
+      }
+    }
+    numFiled -= bucket.size();
+    bucket.clear();
+    if (!frontier.empty()) {
+      phase = kLight;
+      return;
+    }
+
+    // Bucket is empty: heavy edges of everything it held, once
+    if (phase == kLight && !settled.empty()) {
+      frontier.swap(settled);
+      settled.clear();
+      NewStamp(settledStamp, curSettled);
+      phase = kHeavy;
+      return;
+    }
+
+    // Move on to the next non-empty bucket, less than a full turn ahead
+    if (!numFiled) {
+      phase = kDone;
+      return;
+    }
+    do {
+      curBucket++;
+    } while (buckets[curBucket % buckets.size()].empty());
+    phase = kLight;
+  }
+}
+
+// At most NumBuckets() * (number of vertices) for the distances a search
+// reaches, so the conversion does not overflow
+inline uint64_t DeltaStepping::BucketOf(unsigned int v) const {
+  return dist[v].load(std::memory_order_relaxed) / delta;
+}
+
+inline void DeltaStepping::NewStamp(std::vector<unsigned int> &stamps,
+                                    unsigned int &cur) {
+  if (++cur == 0) {
+    // Stamps wrapped around, old entries could look current again
+    std::fill(stamps.begin(), stamps.end(), 0);
+    cur = 1;
+  }
+}
+
+// The distances are final, so the tree is read back from the tight edges
+// (dist[u] + w == dist[v]) by a search from @source. Each vertex keeps the
+// first tight edge that reaches it, which also keeps the tree acyclic with
+// zero-weight edges.
+inline void DeltaStepping::BuildTree(unsigned int source) {
+  std::fill(prev.begin(), prev.end(), -1);
+  std::vector<unsigned int> queue(1, source);
+  std::vector<bool> reached(g.GetNumVertices(), false);
+  reached[source] = true;
+
+  for (size_t i = 0; i < queue.size(); i++) {
+    unsigned int u = queue[i];
+    double distU = GetDist(u);
+    for (const Edge &e : g.GetEdges(u)) {
+      unsigned int v = e.GetEdgeDest();
+      if (!reached[v] && distU + e.GetWeight() == GetDist(v)) {
+        reached[v] = true;
+        prev[v] = u;
+        queue.push_back(v);
+      }
+    }
+  }
+}
+
+#endif  // DELTA_STEPPING_H_
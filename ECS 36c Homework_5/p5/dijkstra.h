@@ -0,0 +1,206 @@
+#ifndef DIJKSTRA_H_
+#define DIJKSTRA_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "graph.h"
+#include "index_min_pq.h"
+#include "search_stats.h"
+
+// Scratch space for Dijkstra that is reused from one query to the next.
+// Entries of dist and prev only hold data when their stamp matches the
+// current query, so starting a new query does not reset all V entries.
+// @Queue is any indexed priority queue with the interface of IndexMinPQ,
+// such as RadixHeap or BucketQueue.
+template <typename Queue>
+class BasicDijkstraWorkspace {
+ public:
+  explicit BasicDijkstraWorkspace(int numVertices);
+  // Uses a copy of @queue, for queues that take more than a capacity
+  BasicDijkstraWorkspace(int numVertices, const Queue &queue);
+  // Invalidate the results of the previous query
+  void NewQuery(void);
+  double GetDist(unsigned int v) const;
+  int GetPrev(unsigned int v) const;
+  void Update(unsigned int v, double dist, int prev);
+  Queue& GetQueue(void);
+  // Searches call CountSettled() for each vertex they pop from the queue.
+  // The count runs over all queries, for benchmarks.
+  void CountSettled(void) { numSettled++; }
+  uint64_t GetNumSettled(void) const { return numSettled; }
+  // Searches call CountRelaxed() for each edge they relax, telling whether
+  // it lowered a distance. A no-op unless built with SEARCH_STATS.
+  void CountRelaxed(bool improved);
+  // Counts of the current query, queue included, without the times
+  SearchStats GetStats(void) const;
+
+ private:
+  std::vector<double> dist;
+  std::vector<int> prev;
+  std::vector<unsigned int> stamp;
+  unsigned int curStamp = 0;
+  uint64_t numSettled = 0;
+#ifdef SEARCH_STATS
+  uint64_t querySettled = 0;  // numSettled when the query started
+  uint64_t numRelaxed = 0, numImproved = 0;
+#endif
+
+  Queue Q;
+};
+
+typedef BasicDijkstraWorkspace<IndexMinPQ<double>> DijkstraWorkspace;
+
+template <typename Queue>
+BasicDijkstraWorkspace<Queue>::BasicDijkstraWorkspace(int numVertices)
+    : dist(numVertices), prev(numVertices), stamp(numVertices, 0),
+      Q(numVertices) {}
+
+template <typename Queue>
+BasicDijkstraWorkspace<Queue>::BasicDijkstraWorkspace(int numVertices,
+                                                      const Queue &queue)
+    : dist(numVertices), prev(numVertices), stamp(numVertices, 0),
+      Q(queue) {}
+
+template <typename Queue>
+void BasicDijkstraWorkspace<Queue>::NewQuery(void) {
+  Q.Clear();
+  if (++curStamp == 0) {
+    // Stamps wrapped around, old entries could look current again
+    std::fill(stamp.begin(), stamp.end(), 0);
+    curStamp = 1;
+  }
+#ifdef SEARCH_STATS
+  querySettled = numSettled;
+  numRelaxed = numImproved = 0;
+#endif
+}
+
+template <typename Queue>
+double BasicDijkstraWorkspace<Queue>::GetDist(unsigned int v) const {
+  if (stamp[v] != curStamp)
+    return std::numeric_limits<double>::max();
+  return dist[v];
+}
+
+template <typename Queue>
+int BasicDijkstraWorkspace<Queue>::GetPrev(unsigned int v) const {
+  if (stamp[v] != curStamp)
+    return -1;
+  return prev[v];
+}
+
+template <typename Queue>
+void BasicDijkstraWorkspace<Queue>::Update(unsigned int v, double d, int p) {
+  stamp[v] = curStamp;
+  dist[v] = d;
+  prev[v] = p;
+}
+
+template <typename Queue>
+Queue& BasicDijkstraWorkspace<Queue>::GetQueue(void) {
+  return Q;
+}
+
+template <typename Queue>
+void BasicDijkstraWorkspace<Queue>::CountRelaxed(bool improved) {
+#ifdef SEARCH_STATS
+  numRelaxed++;
+  numImproved += improved;
+#else
+  (void)improved;
+#endif
+}
+
+template <typename Queue>
+SearchStats BasicDijkstraWorkspace<Queue>::GetStats(void) const {
+  SearchStats stats;
+#ifdef SEARCH_STATS
+  stats.numSettled = numSettled - querySettled;
+  stats.numRelaxed = numRelaxed;
+  stats.numImproved = numImproved;
+  stats.queue = GetQueueStats(Q);
+#endif
+  return stats;
+}
+
+// Dijkstra from @source over the out-edges @edgesOf(u) returns for each
+// vertex u, leaving dist and prev in @ws. Each vertex u is passed to
+// @settled(u) once final, and the search stops when that returns true.
+// Distances add up in double whatever the weight storage of the edges.
+template <typename EdgesOf, typename Settled, typename Queue>
+void SearchAdjacency(EdgesOf edgesOf, Settled settled, unsigned int source,
+                     BasicDijkstraWorkspace<Queue> &ws) {
+  Queue &Q = ws.GetQueue();
+
+  ws.NewQuery();
+  ws.Update(source, 0, -1);
+
+  Q.Push(0, source);
+
+  while (Q.Size()) {
+    unsigned int u = Q.Top();
+    Q.Pop();
+    ws.CountSettled();
+
+    if (settled(u)) {
+      break;
+    }
+    double distU = ws.GetDist(u);
+    for (const auto &e : edgesOf(u)) {
+      unsigned int v = e.GetEdgeDest();
+      double alt = distU + e.GetWeight();
+      bool improved = alt < ws.GetDist(v);
+      ws.CountRelaxed(improved);
+      if (improved) {
+        ws.Update(v, alt, u);
+
+        if (Q.Contains(v))
+          Q.ChangeKey(alt, v);
+        else
+          Q.Push(alt, v);
+      }
+    }
+  }
+}
+
+// Runs Dijkstra on @g; see SearchAdjacency(). Stops as soon as @target is
+// settled, or explores everything reachable if @target is -1. With
+// @reverse, the search follows the reverse adjacency of @g, so the
+// distances are the ones *to* @source.
+template <typename Weight, typename Queue>
+void RunDijkstra(const BasicGraph<Weight> &g, unsigned int source, int target,
+                 bool reverse, BasicDijkstraWorkspace<Queue> &ws) {
+  auto settled = [target](unsigned int u) {
+    return static_cast<int>(u) == target;
+  };
+  if (reverse)
+    SearchAdjacency([&g](unsigned int u) { return g.GetReverseEdges(u); },
+                    settled, source, ws);
+  else
+    SearchAdjacency([&g](unsigned int u) { return g.GetEdges(u); }, settled,
+                    source, ws);
+}
+
+// Runs Dijkstra on @g until every vertex of @targets is settled, or
+// everything reachable is if some are not. Costs O(log |@targets|) per
+// settled vertex on top of the search.
+template <typename Weight, typename Queue>
+void RunDijkstraToTargets(const BasicGraph<Weight> &g, unsigned int source,
+                          std::vector<unsigned int> targets,
+                          BasicDijkstraWorkspace<Queue> &ws) {
+  std::sort(targets.begin(), targets.end());
+  targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+  size_t remaining = targets.size();
+
+  SearchAdjacency([&g](unsigned int u) { return g.GetEdges(u); },
+                  [&targets, &remaining](unsigned int u) {
+                    return std::binary_search(targets.begin(), targets.end(),
+                                              u) && --remaining == 0;
+                  },
+                  source, ws);
+}
+
+#endif  // DIJKSTRA_H_
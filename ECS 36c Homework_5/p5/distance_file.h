@@ -0,0 +1,148 @@
+#ifndef DISTANCE_FILE_H_
+#define DISTANCE_FILE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+const char kTreeFileMagic[4] = {'E', 'W', 'D', 'T'};
+const char kMatrixFileMagic[4] = {'E', 'W', 'D', 'M'};
+const uint32_t kDistanceFileVersion = 1;
+
+enum OutputFormat { kTextFormat, kBinaryFormat };
+
+// Header of a binary shortest path tree. It is followed by dist
+// (numVertices doubles, max() if unreachable) and prev (numVertices int32,
+// -1 for the source and unreachable vertices), in host byte order.
+struct TreeFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t numVertices;
+  uint32_t source;
+};
+
+// Header of a binary distance matrix. It is followed by the source ids
+// (numRows x uint32), the target ids (numCols x uint32), then one row of
+// numCols doubles per source, max() where a target is unreachable.
+struct MatrixFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t numRows;
+  uint32_t numCols;
+};
+
+// Returns -1 and leaves @format alone if @name is not "text" or "binary"
+inline int ParseOutputFormat(const std::string &name, OutputFormat &format) {
+  if (name == "text")
+    format = kTextFormat;
+  else if (name == "binary")
+    format = kBinaryFormat;
+  else
+    return -1;
+  return 0;
+}
+
+// Unreachable vertices print as "inf"
+inline void PrintDistance(std::ostream &os, double dist) {
+  if (dist == std::numeric_limits<double>::max())
+    os << "inf";
+  else
+    os << dist;
+}
+
+// Writes the tree from @source held by @labels (anything with GetDist and
+// GetPrev). The text format has one "v dist prev" line per vertex.
+template <typename Labels>
+void WriteTree(std::ostream &os, OutputFormat format, unsigned int source,
+               int numVertices, const Labels &labels) {
+  if (format == kTextFormat) {
+    std::streamsize precision = os.precision(
+        std::numeric_limits<double>::max_digits10);
+    for (int v = 0; v < numVertices; v++) {
+      os << v << ' ';
+      PrintDistance(os, labels.GetDist(v));
+      os << ' ' << labels.GetPrev(v) << '\n';
+    }
+    os.precision(precision);
+    return;
+  }
+
+  TreeFileHeader header;
+  std::memcpy(header.magic, kTreeFileMagic, sizeof(kTreeFileMagic));
+  header.version = kDistanceFileVersion;
+  header.numVertices = numVertices;
+  header.source = source;
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  std::vector<double> dist(numVertices);
+  std::vector<int32_t> prev(numVertices);
+  for (int v = 0; v < numVertices; v++) {
+    dist[v] = labels.GetDist(v);
+    prev[v] = labels.GetPrev(v);
+  }
+  os.write(reinterpret_cast<const char *>(dist.data()),
+           dist.size() * sizeof(double));
+  os.write(reinterpret_cast<const char *>(prev.data()),
+           prev.size() * sizeof(int32_t));
+}
+
+// Writes a distance matrix one row at a time, so the whole matrix never
+// has to be in memory. The text format has one "src d1 d2 ..." line per
+// source, with the columns in target order.
+class MatrixWriter {
+ public:
+  MatrixWriter(std::ostream &os, OutputFormat format);
+  void WriteHeader(const std::vector<unsigned int> &sources,
+                   const std::vector<unsigned int> &targets);
+  // @row holds one distance per target
+  void WriteRow(unsigned int source, const double *row);
+
+ private:
+  std::ostream &os;
+  OutputFormat format;
+  size_t numCols = 0;
+};
+
+inline MatrixWriter::MatrixWriter(std::ostream &os, OutputFormat format)
+    : os(os), format(format) {
+  if (format == kTextFormat)
+    os.precision(std::numeric_limits<double>::max_digits10);
+}
+
+inline void MatrixWriter::WriteHeader(
+    const std::vector<unsigned int> &sources,
+    const std::vector<unsigned int> &targets) {
+  numCols = targets.size();
+  if (format == kTextFormat)
+    return;
+
+  MatrixFileHeader header;
+  std::memcpy(header.magic, kMatrixFileMagic, sizeof(kMatrixFileMagic));
+  header.version = kDistanceFileVersion;
+  header.numRows = sources.size();
+  header.numCols = targets.size();
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char *>(sources.data()),
+           sources.size() * sizeof(unsigned int));
+  os.write(reinterpret_cast<const char *>(targets.data()),
+           targets.size() * sizeof(unsigned int));
+}
+
+inline void MatrixWriter::WriteRow(unsigned int source, const double *row) {
+  if (format == kBinaryFormat) {
+    os.write(reinterpret_cast<const char *>(row), numCols * sizeof(double));
+    return;
+  }
+
+  os << source;
+  for (size_t i = 0; i < numCols; i++) {
+    os << ' ';
+    PrintDistance(os, row[i]);
+  }
+  os << '\n';
+}
+
+#endif  // DISTANCE_FILE_H_
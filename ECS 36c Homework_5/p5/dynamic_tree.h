@@ -0,0 +1,225 @@
+#ifndef DYNAMIC_TREE_H_
+#define DYNAMIC_TREE_H_
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "graph.h"
+#include "index_min_pq.h"
+
+// Shortest path tree from one source that is kept current while the graph
+// changes, after Ramalingam and Reps. An edge that gets cheaper only
+// revisits the vertices it improves. An edge of the tree that gets dearer
+// or disappears only recomputes the subtree below it, seeded from the
+// edges entering the subtree. Needs the reverse adjacency of the graph.
+class DynamicShortestPathTree {
+ public:
+  explicit DynamicShortestPathTree(int numVertices);
+  // Full Dijkstra from @source
+  void Build(const Graph &g, unsigned int source);
+  unsigned int GetSource(void) const;
+  double GetDist(unsigned int v) const;
+  int GetPrev(unsigned int v) const;
+  // Number of vertices the last repair revisited
+  unsigned int GetNumAffected(void) const;
+
+  // Apply the update to @g, then repair the tree
+  // Return -1 if @g rejected the update, 0 otherwise
+  int InsertEdge(Graph &g, unsigned int u, unsigned int v, double weight);
+  int DeleteEdge(Graph &g, unsigned int u, unsigned int v);
+  int SetEdgeWeight(Graph &g, unsigned int u, unsigned int v, double weight);
+
+ private:
+  // The edge u -> v of @weight appeared or got cheaper
+  void Decrease(const Graph &g, unsigned int u, unsigned int v,
+                double weight);
+  // The tree edge into @v got dearer or disappeared
+  void Increase(const Graph &g, unsigned int v);
+  // Dijkstra from the vertices already queued. With @restricted, only
+  // vertices marked affected are relaxed; the others cannot improve.
+  void Propagate(const Graph &g, bool restricted);
+  // Weight of the first edge u -> v, the one Graph updates
+  static double FirstWeight(const Graph &g, unsigned int u, unsigned int v);
+
+  unsigned int source = 0;
+  std::vector<double> dist;
+  std::vector<int> prev;
+  IndexMinPQ<double> Q;
+  std::vector<bool> affected;
+  std::vector<unsigned int> affectedList;
+  unsigned int numAffected = 0;
+};
+
+inline DynamicShortestPathTree::DynamicShortestPathTree(int numVertices)
+    : dist(numVertices, std::numeric_limits<double>::max()),
+      prev(numVertices, -1), Q(numVertices), affected(numVertices, false) {}
+
+inline void DynamicShortestPathTree::Build(const Graph &g,
+                                           unsigned int source) {
+  this->source = source;
+  std::fill(dist.begin(), dist.end(), std::numeric_limits<double>::max());
+  std::fill(prev.begin(), prev.end(), -1);
+
+  dist[source] = 0;
+  numAffected = 0;
+  Q.Clear();
+  Q.Push(0, source);
+  Propagate(g, false);
+}
+
+inline unsigned int DynamicShortestPathTree::GetSource(void) const {
+  return source;
+}
+
+inline double DynamicShortestPathTree::GetDist(unsigned int v) const {
+  return dist[v];
+}
+
+inline int DynamicShortestPathTree::GetPrev(unsigned int v) const {
+  return prev[v];
+}
+
+inline unsigned int DynamicShortestPathTree::GetNumAffected(void) const {
+  return numAffected;
+}
+
+inline double DynamicShortestPathTree::FirstWeight(const Graph &g,
+                                                   unsigned int u,
+                                                   unsigned int v) {
+  for (const Edge &e : g.GetEdges(u)) {
+    if (e.GetEdgeDest() == v)
+      return e.GetWeight();
+  }
+  return std::numeric_limits<double>::max();
+}
+
+inline int DynamicShortestPathTree::InsertEdge(Graph &g, unsigned int u,
+                                               unsigned int v,
+                                               double weight) {
+  if (g.InsertEdge(u, v, weight) == -1)
+    return -1;
+  // Compact weight storages round the weight
+  Decrease(g, u, v, Edge(v, weight).GetWeight());
+  return 0;
+}
+
+inline int DynamicShortestPathTree::DeleteEdge(Graph &g, unsigned int u,
+                                               unsigned int v) {
+  if (g.DeleteEdge(u, v) == -1)
+    return -1;
+
+  // Only losing a tree edge can lengthen a path
+  numAffected = 0;
+  if (prev[v] == static_cast<int>(u))
+    Increase(g, v);
+  return 0;
+}
+
+inline int DynamicShortestPathTree::SetEdgeWeight(Graph &g, unsigned int u,
+                                                  unsigned int v,
+                                                  double weight) {
+  // Graph reports invalid vertices
+  if (u >= dist.size() || v >= dist.size())
+    return g.SetEdgeWeight(u, v, weight);
+
+  double old = FirstWeight(g, u, v);
+  if (g.SetEdgeWeight(u, v, weight) == -1)
+    return -1;
+  weight = Edge(v, weight).GetWeight();
+
+  numAffected = 0;
+  if (weight < old)
+    Decrease(g, u, v, weight);
+  else if (weight > old && prev[v] == static_cast<int>(u))
+    Increase(g, v);
+  return 0;
+}
+
+inline void DynamicShortestPathTree::Decrease(const Graph &g, unsigned int u,
+                                              unsigned int v, double weight) {
+  numAffected = 0;
+  if (dist[u] == std::numeric_limits<double>::max())
+    return;
+
+  double alt = dist[u] + weight;
+  if (alt < dist[v]) {
+    dist[v] = alt;
+    prev[v] = u;
+    Q.Push(alt, v);
+    Propagate(g, false);
+  }
+}
+
+inline void DynamicShortestPathTree::Increase(const Graph &g,
+                                              unsigned int v) {
+  // The subtree of v, found through the out-edges since every tree edge is
+  // a graph edge
+  affectedList.assign(1, v);
+  affected[v] = true;
+  for (size_t i = 0; i < affectedList.size(); i++) {
+    unsigned int x = affectedList[i];
+    for (const Edge &e : g.GetEdges(x)) {
+      unsigned int y = e.GetEdgeDest();
+      if (!affected[y] && prev[y] == static_cast<int>(x)) {
+        affected[y] = true;
+        affectedList.push_back(y);
+      }
+    }
+  }
+
+  for (unsigned int x : affectedList) {
+    dist[x] = std::numeric_limits<double>::max();
+    prev[x] = -1;
+  }
+
+  // Best way into the subtree from the unchanged part of the tree
+  for (unsigned int x : affectedList) {
+    for (const Edge &e : g.GetReverseEdges(x)) {
+      unsigned int p = e.GetEdgeDest();
+      if (affected[p] || dist[p] == std::numeric_limits<double>::max())
+        continue;
+      double alt = dist[p] + e.GetWeight();
+      if (alt < dist[x]) {
+        dist[x] = alt;
+        prev[x] = p;
+      }
+    }
+    if (dist[x] != std::numeric_limits<double>::max())
+      Q.Push(dist[x], x);
+  }
+
+  Propagate(g, true);
+
+  for (unsigned int x : affectedList)
+    affected[x] = false;
+  numAffected = affectedList.size();
+}
+
+inline void DynamicShortestPathTree::Propagate(const Graph &g,
+                                               bool restricted) {
+  while (Q.Size()) {
+    unsigned int u = Q.Top();
+    Q.Pop();
+    if (!restricted)
+      numAffected++;
+
+    for (const Edge &e : g.GetEdges(u)) {
+      unsigned int v = e.GetEdgeDest();
+      if (restricted && !affected[v])
+        continue;
+      double alt = dist[u] + e.GetWeight();
+      if (alt < dist[v]) {
+        dist[v] = alt;
+        prev[v] = u;
+
+        if (Q.Contains(v))
+          Q.ChangeKey(alt, v);
+        else
+          Q.Push(alt, v);
+      }
+    }
+  }
+}
+
+#endif  // DYNAMIC_TREE_H_
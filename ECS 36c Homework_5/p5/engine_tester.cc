@@ -0,0 +1,320 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arc_flags.h"
+#include "bucket_queue.h"
+#include "compressed_graph.h"
+#include "contraction_hierarchy.h"
+#include "delta_stepping.h"
+#include "dijkstra.h"
+#include "dynamic_tree.h"
+#include "graph.h"
+#include "hub_labels.h"
+#include "landmarks.h"
+#include "radix_heap.h"
+#include "reorder.h"
+#include "shortest_path.h"
+#include "tree_cache.h"
+
+typedef std::vector<std::pair<int, int>> Queries;
+// Distance from every source to every vertex, by plain Dijkstra
+typedef std::vector<std::vector<double>> Distances;
+
+const double kUnreachable = std::numeric_limits<double>::max();
+
+// Index files go in the current directory, named after the process
+const std::string kScratch = "engine_tester." + std::to_string(getpid());
+
+Distances RunReference(const Graph &g) {
+  DijkstraWorkspace ws(g.GetNumVertices());
+  Distances dist(g.GetNumVertices());
+  for (int s = 0; s < g.GetNumVertices(); s++) {
+    RunDijkstra(g, s, -1, false, ws);
+    for (int v = 0; v < g.GetNumVertices(); v++)
+      dist[s].push_back(ws.GetDist(v));
+  }
+  return dist;
+}
+
+// Distances summed in another order, as by shortcuts, may differ in the
+// last bits
+bool Same(double a, double b) {
+  return a == b || std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b));
+}
+
+// Returns whether @path, from @dst back to @src, follows edges of @g and
+// adds up to @dist
+bool IsPath(const Graph &g, const std::vector<int> &path, int src, int dst,
+            double dist) {
+  if (path.empty() || path.front() != dst || path.back() != src)
+    return false;
+
+  double total = 0;
+  for (size_t i = path.size() - 1; i >= 1; i--) {
+    double weight = kUnreachable;
+    for (const Edge &e : g.GetEdges(path[i])) {
+      if (static_cast<int>(e.GetEdgeDest()) == path[i - 1])
+        weight = std::min(weight, e.GetWeight());
+    }
+    if (weight == kUnreachable)
+      return false;
+    total += weight;
+  }
+  return Same(total, dist);
+}
+
+// Returns whether @sp holds the shortest path of @g from @src to @dst
+bool IsShortest(const Graph &g, const Distances &dist, const ShortestPath &sp,
+                int src, int dst) {
+  double expected = dist[src][dst];
+  if (expected == kUnreachable)
+    return sp.GetPath().empty() && sp.GetDistance() == kUnreachable;
+  return Same(sp.GetDistance(), expected)
+      && IsPath(g, sp.GetPath(), src, dst, expected);
+}
+
+// Answers each of @queries with search(path) and counts the answers that
+// are not shortest paths
+template <typename Search>
+int CheckQueries(const Graph &g, const Distances &dist,
+                 const Queries &queries, Search search) {
+  int mismatches = 0;
+  for (const std::pair<int, int> &query : queries) {
+    ShortestPath path(query.first, query.second);
+    search(path);
+    mismatches += !IsShortest(g, dist, path, query.first, query.second);
+  }
+  return mismatches;
+}
+
+// Runs random updates on a copy of @g through a dynamic tree from each
+// source in @sources, checking the repaired tree against a new search
+// after each one
+int CheckDynamicTree(const Graph &g, const std::vector<int> &sources) {
+  const int kNumUpdates = 100;
+  std::mt19937 rng(1);
+  int mismatches = 0;
+  int n = g.GetNumVertices();
+
+  for (int source : sources) {
+    Graph copy;
+    copy.CopyFrom(g);
+    copy.BuildReverse();
+    DynamicShortestPathTree tree(n);
+    tree.Build(copy, source);
+    DijkstraWorkspace ws(n);
+
+    for (int i = 0; i < kNumUpdates; i++) {
+      unsigned int u = rng() % n;
+      double weight = rng() % 1000 / 1000.0;
+      int op = rng() % 3;
+      if (op == 0 || !copy.GetEdges(u).size()) {
+        tree.InsertEdge(copy, u, rng() % n, weight);
+      } else {
+        unsigned int v = copy.GetEdges(u).begin()->GetEdgeDest();
+        if (op == 1)
+          tree.DeleteEdge(copy, u, v);
+        else
+          tree.SetEdgeWeight(copy, u, v, weight);
+      }
+
+      RunDijkstra(copy, source, -1, false, ws);
+      for (int v = 0; v < n; v++) {
+        ShortestPath path(source, v);
+        path.FromTree(tree);
+        bool same = ws.GetDist(v) == kUnreachable
+            ? path.GetPath().empty()
+            : Same(path.GetDistance(), ws.GetDist(v))
+                && IsPath(copy, path.GetPath(), source, v, ws.GetDist(v));
+        mismatches += !same;
+      }
+    }
+  }
+  return mismatches;
+}
+
+// Saves @index, then loads it back for @g, which should work, and for
+// @other, which should not
+template <typename Index>
+int CheckIndexFile(const Index &index, const Graph &g, const Graph &other) {
+  std::ostringstream errors;
+  std::streambuf *saved = std::cerr.rdbuf(errors.rdbuf());
+  Index loaded, rejected;
+  int mismatches = index.Save(kScratch) != 0;
+  mismatches += loaded.Load(kScratch, g) != 0;
+  mismatches += rejected.Load(kScratch, other) != -1;
+  std::remove(kScratch.c_str());
+  std::cerr.rdbuf(saved);
+  return mismatches;
+}
+
+// Checks every engine on the graph of @fileName, with queries from every
+// @step-th source to every vertex
+// Returns the number of mismatches
+int CheckGraph(const std::string &fileName, int step) {
+  Graph g;
+  if (g.Load(fileName) == -1)
+    return 1;
+  g.BuildReverse();
+  int n = g.GetNumVertices();
+  Distances dist = RunReference(g);
+
+  // Queries in random order, so that the tree cache both hits and evicts
+  Queries queries;
+  std::vector<int> sources;
+  for (int s = 0; s < n; s += step) {
+    sources.push_back(s);
+    for (int t = 0; t < n; t++)
+      queries.push_back(std::make_pair(s, t));
+  }
+  std::shuffle(queries.begin(), queries.end(), std::mt19937(1));
+
+  int total = 0;
+  auto report = [&fileName, &total](const std::string &name,
+                                    int mismatches) {
+    // Mismatches should be 0
+    std::cout << fileName << " " << name << " mismatches= " << mismatches
+              << std::endl;
+    total += mismatches;
+  };
+
+  BasicDijkstraWorkspace<RadixHeap<double>> radix(n);
+  report("radix heap", CheckQueries(g, dist, queries,
+      [&g, &radix](ShortestPath &path) { path.Dijkstra(g, radix); }));
+
+  double minWeight = kUnreachable, maxWeight = 0;
+  for (int u = 0; u < n; u++) {
+    for (const Edge &e : g.GetEdges(u)) {
+      minWeight = std::min(minWeight, e.GetWeight());
+      maxWeight = std::max(maxWeight, e.GetWeight());
+    }
+  }
+  BasicDijkstraWorkspace<BucketQueue<double>> dial(
+      n, BucketQueue<double>(n, minWeight, maxWeight));
+  report("bucket queue", CheckQueries(g, dist, queries,
+      [&g, &dial](ShortestPath &path) { path.Dijkstra(g, dial); }));
+
+  DijkstraWorkspace fwd(n), bwd(n);
+  report("bidirectional", CheckQueries(g, dist, queries,
+      [&g, &fwd, &bwd](ShortestPath &path) {
+        path.BidirectionalDijkstra(g, fwd, bwd);
+      }));
+
+  Landmarks landmarks;
+  landmarks.Build(g, 4);
+  report("ALT", CheckQueries(g, dist, queries,
+      [&g, &landmarks, &fwd](ShortestPath &path) {
+        path.AStar(g, landmarks, fwd);
+      }));
+
+  ContractionHierarchy hierarchy;
+  hierarchy.Build(g);
+  report("contraction hierarchy", CheckQueries(g, dist, queries,
+      [&hierarchy, &fwd, &bwd](ShortestPath &path) {
+        path.HierarchyQuery(hierarchy, fwd, bwd);
+      }));
+
+  HubLabels hubLabels;
+  hubLabels.Build(g);
+  report("hub labels", CheckQueries(g, dist, queries,
+      [&g, &hubLabels, &fwd](ShortestPath &path) {
+        path.HubLabelQuery(g, hubLabels, fwd);
+      }));
+
+  ArcFlags arcFlags;
+  arcFlags.Build(g, 4);
+  report("arc flags", CheckQueries(g, dist, queries,
+      [&g, &arcFlags, &fwd](ShortestPath &path) {
+        path.ArcFlagDijkstra(g, arcFlags, fwd);
+      }));
+
+  DeltaStepping deltaStepping(g, DeltaStepping::DefaultDelta(g), 2);
+  report("delta-stepping", CheckQueries(g, dist, queries,
+      [&deltaStepping](ShortestPath &path) {
+        path.DeltaSteppingSearch(deltaStepping);
+      }));
+
+  CompressedGraph compressed;
+  compressed.Build(g);
+  report("compressed graph", CheckQueries(g, dist, queries,
+      [&compressed, &fwd](ShortestPath &path) {
+        path.Dijkstra(compressed, fwd);
+      }));
+
+  // Searches on the renumbered copy, with the paths mapped back
+  for (VertexOrder order : {kBfsOrder, kRcmOrder}) {
+    Graph reordered;
+    reordered.CopyFrom(g);
+    std::vector<unsigned int> newId = ComputeOrder(reordered, order);
+    std::vector<unsigned int> oldId(n);
+    for (int u = 0; u < n; u++)
+      oldId[newId[u]] = u;
+    reordered.Renumber(newId);
+    report(order == kBfsOrder ? "reorder bfs" : "reorder rcm",
+           CheckQueries(g, dist, queries,
+               [&reordered, &newId, &oldId, &fwd](ShortestPath &path) {
+                 path.Renumber(newId);
+                 path.Dijkstra(reordered, fwd);
+                 path.Renumber(oldId);
+               }));
+  }
+
+  // Room for about 3 trees of dist and prev labels
+  TreeCache cache(3 * n * (sizeof(double) + sizeof(int)));
+  report("tree cache", CheckQueries(g, dist, queries,
+      [&g, &cache, &fwd](ShortestPath &path) {
+        path.CachedDijkstra(g, cache, fwd);
+      }));
+  // Evicted trees should be above 0 (1)
+  bool evicted = cache.GetNumEvictions() > 0;
+  std::cout << fileName << " tree cache evicted= " << evicted << std::endl;
+  total += !evicted;
+
+  int mismatches = 0;
+  for (int s : sources) {
+    std::vector<ShortestPath> paths;
+    for (int t = 0; t < n; t++)
+      paths.push_back(ShortestPath(s, t));
+    ShortestPath::MultiTargetDijkstra(g, paths, fwd);
+    for (int t = 0; t < n; t++)
+      mismatches += !IsShortest(g, dist, paths[t], s, t);
+  }
+  report("multi-target", mismatches);
+
+  report("dynamic tree", CheckDynamicTree(g, sources));
+
+  // Index files of another graph of the same size are rejected
+  Graph other;
+  other.CopyFrom(g);
+  for (int u = 0; u < n; u++) {
+    if (other.GetEdges(u).size()) {
+      const Edge &e = *other.GetEdges(u).begin();
+      other.SetEdgeWeight(u, e.GetEdgeDest(), e.GetWeight() + 1);
+      break;
+    }
+  }
+  report("index files", CheckIndexFile(landmarks, g, other)
+      + CheckIndexFile(hierarchy, g, other)
+      + CheckIndexFile(hubLabels, g, other)
+      + CheckIndexFile(arcFlags, g, other));
+
+  return total;
+}
+
+// Tester
+int main() {
+  int mismatches = CheckGraph("test_cases/tinyEWD.txt", 1)
+      + CheckGraph("test_cases/mediumEWD.txt", 10);
+
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+#ifndef EWD_TEXT_H_
+#define EWD_TEXT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Number fields of EWD text, read straight out of a buffer the way
+// std::istream >> reads them in the C locale. A field starts at @p, which
+// must not be whitespace, and ends at the first character that cannot
+// extend it. Each Parse function advances @p past the field, and returns
+// false where >> would fail.
+
+inline bool IsTextSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline const char* SkipTextSpace(const char *p, const char *end) {
+  while (p != end && IsTextSpace(*p))
+    p++;
+  return p;
+}
+
+// Optional sign and decimal digits, failing past @limit like >> does
+inline bool ParseMagnitude(const char *&p, const char *end, uint64_t limit,
+                           bool &negative, uint64_t &magnitude) {
+  negative = p != end && *p == '-';
+  if (p != end && (*p == '-' || *p == '+'))
+    p++;
+
+  const char *digits = p;
+  magnitude = 0;
+  while (p != end && *p >= '0' && *p <= '9') {
+    magnitude = magnitude * 10 + (*p++ - '0');
+    if (magnitude > limit)
+      return false;
+  }
+  return p != digits;
+}
+
+inline bool ParseIntField(const char *&p, const char *end, int &value) {
+  bool negative;
+  uint64_t magnitude;
+
+  if (!ParseMagnitude(p, end, uint64_t(INT32_MAX) + 1, negative, magnitude)
+      || (!negative && magnitude > uint64_t(INT32_MAX)))
+    return false;
+  value = negative ? -int64_t(magnitude) : magnitude;
+  return true;
+}
+
+// A minus sign wraps around, as with >> into an unsigned int
+inline bool ParseUnsignedField(const char *&p, const char *end,
+                               unsigned int &value) {
+  bool negative;
+  uint64_t magnitude;
+
+  if (!ParseMagnitude(p, end, UINT32_MAX, negative, magnitude))
+    return false;
+  value = negative ? 0u - magnitude : magnitude;
+  return true;
+}
+
+// Decimal mantissa with an optional exponent. A mantissa of at most 2^53
+// scaled by at most 10^22 converts exactly, as both factors are exact
+// doubles and the product or quotient is rounded once; anything else goes
+// to strtod. Overflow fails, underflow does not.
+inline bool ParseDoubleField(const char *&p, const char *end,
+                             double &value) {
+  static const double kPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char *start = p;
+  bool negative = p != end && *p == '-';
+  if (p != end && (*p == '-' || *p == '+'))
+    p++;
+
+  // Significant digits past the 19th no longer fit and are dropped; the
+  // mantissa is then too large for the exact path anyway
+  uint64_t mantissa = 0;
+  int numDigits = 0, numKept = 0, exponent = 0;
+  for (int fraction = 0; fraction < 2; fraction++) {
+    for (; p != end && *p >= '0' && *p <= '9'; p++, numDigits++) {
+      if (numKept == 19) {
+        exponent += !fraction;
+        continue;
+      }
+      mantissa = mantissa * 10 + (*p - '0');
+      numKept += mantissa != 0;
+      exponent -= fraction;
+    }
+    if (fraction || p == end || *p != '.')
+      break;
+    p++;
+  }
+  if (numDigits == 0)
+    return false;
+
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negativeExponent = p != end && *p == '-';
+    if (p != end && (*p == '-' || *p == '+'))
+      p++;
+    const char *digits = p;
+    int magnitude = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; p++)
+      magnitude = std::min(magnitude * 10 + (*p - '0'), 100000);
+    if (p == digits)
+      return false;
+    exponent += negativeExponent ? -magnitude : magnitude;
+  }
+
+  if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+    value = exponent < 0 ? mantissa / kPowersOfTen[-exponent]
+                         : mantissa * kPowersOfTen[exponent];
+    value = negative ? -value : value;
+    return true;
+  }
+  value = std::strtod(std::string(start, p).c_str(), nullptr);
+  return value != HUGE_VAL && value != -HUGE_VAL;
+}
+
+#endif  // EWD_TEXT_H_
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <string>
+
+#include "compressed_graph.h"
+#include "graph.h"
+
+// Converts an EWD text graph into the binary format that Graph maps in place,
+// or with --compress into the format of CompressedGraph
+int main(int argc, char *argv[]) {
+  bool compress = argc == 4 && std::string(argv[1]) == "--compress";
+
+  if (argc != 3 && !compress) {
+    std::cerr << "Usage: " << argv[0] << " [--compress] <graph.txt>"
+              << " <graph.bin>" << std::endl;
+    return 1;
+  }
+  const char *input = argv[argc - 2];
+  const char *output = argv[argc - 1];
+
+  Graph graph;
+
+  if (graph.ExtractFile(input) == -1)
+    return 1;
+
+  if (!compress) {
+    if (graph.WriteBinaryFile(output) == -1)
+      return 1;
+
+    std::cout << output << ": " << graph.GetNumVertices() << " vertices, "
+              << graph.GetNumEdges() << " edges" << std::endl;
+    return 0;
+  }
+
+  CompressedGraph compressed;
+  compressed.Build(graph);
+  if (compressed.WriteFile(output) == -1)
+    return 1;
+
+  // The plain layout holds the Edge records and uint32 offsets
+  double plainBits = 0;
+  if (graph.GetNumEdges()) {
+    plainBits = 8.0 * (sizeof(Edge) * graph.GetNumEdges()
+        + sizeof(uint32_t) * (graph.GetNumVertices() + 1.0))
+        / graph.GetNumEdges();
+  }
+  std::cout << output << ": " << graph.GetNumVertices() << " vertices, "
+            << graph.GetNumEdges() << " edges, "
+            << compressed.GetBitsPerEdge() << " bits per edge against "
+            << plainBits << " uncompressed" << std::endl;
+
+  return 0;
+}
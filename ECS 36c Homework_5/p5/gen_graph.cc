@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Edge of a generated graph, before the vertices are shuffled
+struct GenEdge {
+  unsigned int src, dst;
+  double weight;
+};
+
+typedef std::mt19937_64 Random;
+
+// Uniform weight in (0, 1], so that every weight is positive
+double RandomWeight(Random &rng) {
+  return 1 - std::uniform_real_distribution<double>(0, 1)(rng);
+}
+
+// The generators below fill @edges and return the number of vertices,
+// which the lattices round to a square
+
+// @n points in the unit square, with an edge both ways between any two
+// that are closer than the radius giving @degree neighbours on average.
+// Weights are the distances, like in the EWD files.
+int Geometric(int n, double degree, Random &rng,
+              std::vector<GenEdge> &edges) {
+  std::uniform_real_distribution<double> coord(0, 1);
+  std::vector<double> x(n), y(n);
+  for (int v = 0; v < n; v++) {
+    x[v] = coord(rng);
+    y[v] = coord(rng);
+  }
+
+  // Points are bucketed into cells of the radius, so only the 3 x 3 cells
+  // around a point hold its neighbours
+  double radius = std::sqrt(degree / (M_PI * n));
+  int side = std::max(1, std::min(4096, static_cast<int>(1 / radius)));
+  std::vector<std::vector<unsigned int>> cells(side * side);
+  auto cellOf = [side](double c) {
+    return std::min(side - 1, static_cast<int>(c * side));
+  };
+  for (int v = 0; v < n; v++)
+    cells[cellOf(y[v]) * side + cellOf(x[v])].push_back(v);
+
+  for (int u = 0; u < n; u++) {
+    int cx = cellOf(x[u]), cy = cellOf(y[u]);
+    for (int ny = std::max(0, cy - 1); ny <= std::min(side - 1, cy + 1);
+         ny++) {
+      for (int nx = std::max(0, cx - 1); nx <= std::min(side - 1, cx + 1);
+           nx++) {
+        for (unsigned int v : cells[ny * side + nx]) {
+          double d = std::hypot(x[u] - x[v], y[u] - y[v]);
+          if (v != static_cast<unsigned int>(u) && d <= radius)
+            edges.push_back({static_cast<unsigned int>(u), v, d});
+        }
+      }
+    }
+  }
+  return n;
+}
+
+// Square lattice of about @n vertices with random weights, linking each
+// vertex both ways to its 4 neighbours, or to its 8 neighbours when
+// @degree is at least 8
+int Grid(int n, double degree, Random &rng, std::vector<GenEdge> &edges) {
+  int side = std::max(1, static_cast<int>(std::lround(std::sqrt(n))));
+  int numOffsets = degree >= 8 ? 4 : 2;
+  const int kOffsets[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+
+  for (int r = 0; r < side; r++) {
+    for (int c = 0; c < side; c++) {
+      for (int i = 0; i < numOffsets; i++) {
+        int nr = r + kOffsets[i][0], nc = c + kOffsets[i][1];
+        if (nr >= side || nc < 0 || nc >= side)
+          continue;
+        unsigned int u = r * side + c, v = nr * side + nc;
+        edges.push_back({u, v, RandomWeight(rng)});
+        edges.push_back({v, u, RandomWeight(rng)});
+      }
+    }
+  }
+  return side * side;
+}
+
+// Preferential attachment (Barabasi and Albert): each new vertex links
+// both ways to @degree / 2 distinct earlier vertices, picked in proportion
+// to their degree, so a few hubs end up with most of the edges
+int PowerLaw(int n, double degree, Random &rng,
+             std::vector<GenEdge> &edges) {
+  int m = std::max(1, static_cast<int>(degree / 2));
+  // Every endpoint of every edge, so a uniform pick is degree-weighted
+  std::vector<unsigned int> ends;
+  std::vector<unsigned int> picked;
+
+  for (int v = 1; v < n; v++) {
+    picked.clear();
+    if (v <= m) {
+      // The first vertices link to all earlier ones
+      for (int u = 0; u < v; u++)
+        picked.push_back(u);
+    } else {
+      while (static_cast<int>(picked.size()) < m) {
+        unsigned int u = ends[rng() % ends.size()];
+        if (std::find(picked.begin(), picked.end(), u) == picked.end())
+          picked.push_back(u);
+      }
+    }
+    for (unsigned int u : picked) {
+      edges.push_back({static_cast<unsigned int>(v), u, RandomWeight(rng)});
+      edges.push_back({u, static_cast<unsigned int>(v), RandomWeight(rng)});
+      ends.push_back(u);
+      ends.push_back(v);
+    }
+  }
+  return n;
+}
+
+// Road-like network on about @n jittered lattice points: each lattice
+// street is kept with probability @degree / 4, and one in twenty kept
+// streets is one-way. Weights are travel times, the length over a random
+// speed, with every eighth row and column a highway four times as fast.
+int Road(int n, double degree, Random &rng, std::vector<GenEdge> &edges) {
+  int side = std::max(1, static_cast<int>(std::lround(std::sqrt(n))));
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::vector<double> x(side * side), y(side * side);
+  for (int v = 0; v < side * side; v++) {
+    x[v] = (v % side + 0.8 * unit(rng)) / side;
+    y[v] = (v / side + 0.8 * unit(rng)) / side;
+  }
+
+  double keep = std::min(1.0, degree / 4);
+  for (int r = 0; r < side; r++) {
+    for (int c = 0; c < side; c++) {
+      for (int down = 0; down < 2; down++) {
+        int nr = r + down, nc = c + !down;
+        if (nr >= side || nc >= side || unit(rng) >= keep)
+          continue;
+        unsigned int u = r * side + c, v = nr * side + nc;
+        bool highway = down ? c % 8 == 0 : r % 8 == 0;
+        double speed = (highway ? 4 : 1) * (0.5 + unit(rng));
+        double time = std::hypot(x[u] - x[v], y[u] - y[v]) / speed;
+        if (unit(rng) >= 0.05) {
+          edges.push_back({u, v, time});
+          edges.push_back({v, u, time});
+        } else if (unit(rng) < 0.5) {
+          edges.push_back({u, v, time});
+        } else {
+          edges.push_back({v, u, time});
+        }
+      }
+    }
+  }
+  return side * side;
+}
+
+// Writes a synthetic graph in the EWD text format to standard output, for
+// benchmarks at any size and density. Vertex ids are shuffled, as a file
+// would not list related vertices together either.
+int main(int argc, char *argv[]) {
+  if (argc != 4 && argc != 5) {
+    std::cerr << "Usage: " << argv[0] << " geometric|grid|powerlaw|road"
+              << " <vertices> <degree> [seed]" << std::endl;
+    std::cerr << "       <degree> is the average out-degree; a grid links"
+              << " 4 neighbours, or 8 from 8 up" << std::endl;
+    return 1;
+  }
+  std::string kind(argv[1]);
+  int n = std::atoi(argv[2]);
+  double degree = std::atof(argv[3]);
+  Random rng(argc == 5 ? std::strtoull(argv[4], nullptr, 10) : 1);
+
+  if (n <= 0 || !(degree > 0)) {
+    std::cerr << "Error: invalid size or degree" << std::endl;
+    return 1;
+  }
+
+  std::vector<GenEdge> edges;
+  if (kind == "geometric") {
+    n = Geometric(n, degree, rng, edges);
+  } else if (kind == "grid") {
+    n = Grid(n, degree, rng, edges);
+  } else if (kind == "powerlaw") {
+    n = PowerLaw(n, degree, rng, edges);
+  } else if (kind == "road") {
+    n = Road(n, degree, rng, edges);
+  } else {
+    std::cerr << "Error: unknown graph kind " << kind << std::endl;
+    return 1;
+  }
+
+  std::vector<unsigned int> id(n);
+  for (int v = 0; v < n; v++)
+    id[v] = v;
+  std::shuffle(id.begin(), id.end(), rng);
+
+  // Six decimals like FixedWeight keeps; weights stay positive
+  std::printf("%d\n", n);
+  for (const GenEdge &e : edges) {
+    std::printf("%u %u %.6f\n", id[e.src], id[e.dst],
+                std::max(e.weight, 1e-6));
+  }
+  return std::fflush(stdout) == 0 ? 0 : 1;
+}
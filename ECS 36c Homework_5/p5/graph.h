@@ -0,0 +1,1054 @@
+#ifndef GRAPH_H_
+#define GRAPH_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ewd_text.h"
+
+// Storage of edge weights. Every policy turns a weight into its stored
+// form with Encode() and back into a double with Decode(), and searches
+// always add up decoded weights in double. Fits() tells whether a
+// non-negative weight can be stored, and kFileFormat tags binary files.
+//
+// DoubleWeight stores weights exactly, and pads an edge to 16 bytes.
+struct DoubleWeight {
+  typedef double Stored;
+  static const uint32_t kFileFormat = 0;
+  static Stored Encode(double weight) { return weight; }
+  static double Decode(Stored stored) { return stored; }
+  static bool Fits(double) { return true; }
+};
+
+// FloatWeight rounds each weight to the nearest float, for 8-byte edges.
+// Every weight is then off by at most 2^-24 of its value, and since the
+// weights are non-negative, so is the length of every path. A search may
+// pick another path when two lengths are that close.
+struct FloatWeight {
+  typedef float Stored;
+  static const uint32_t kFileFormat = 1;
+  static Stored Encode(double weight) { return weight; }
+  static double Decode(Stored stored) { return stored; }
+  static bool Fits(double weight) { return weight <= FLT_MAX; }
+};
+
+// FixedWeight stores each weight as a whole number of millionths, for
+// 8-byte edges and weights up to about 4294.97. Weights with at most six
+// decimals, like those of EWD files, decode to exactly the double parsed
+// from the text, so results match DoubleWeight. Otherwise each weight is
+// off by at most 5e-7, and a path of k edges by at most k times that.
+struct FixedWeight {
+  typedef uint32_t Stored;
+  static const uint32_t kFileFormat = 2;
+  static constexpr double kScale = 1e6;
+  static Stored Encode(double weight) { return std::llround(weight * kScale); }
+  static double Decode(Stored stored) { return stored / kScale; }
+  static bool Fits(double weight) { return weight * kScale <= UINT32_MAX; }
+};
+
+// Out-edge of a vertex, with its weight stored as @Weight says
+template <typename Weight>
+class BasicEdge {
+ public:
+  BasicEdge() = default;
+  BasicEdge(unsigned int dest, double weight);
+  unsigned int GetEdgeDest(void) const;
+  double GetWeight(void) const;
+
+  template <typename W>
+  friend std::ostream& operator <<(std::ostream &os, const BasicEdge<W> &e);
+ private:
+  unsigned int edgeDestVertex = 0;
+  typename Weight::Stored weight = 0;
+};
+
+// Contiguous slice of the packed edge array holding one vertex's out-edges
+template <typename E>
+class BasicEdgeRange {
+ public:
+  BasicEdgeRange(const E *first, const E *last) : first(first), last(last) {}
+  const E* begin(void) const { return first; }
+  const E* end(void) const { return last; }
+  unsigned int size(void) const { return last - first; }
+
+ private:
+  const E *first, *last;
+};
+
+// Adjacency arrays that can be edited in place: the edges of vertex u are
+// edges[begin[u]] to edges[end[u] - 1], with free slots up to cap[u]. A
+// list that runs out of slots moves to the back of the array with twice
+// the room, and the array is compacted once the abandoned slots outnumber
+// the edges, so an update costs amortized time in the degree of its vertex.
+template <typename E>
+class BasicEditableAdjacency {
+ public:
+  // Takes a CSR adjacency (offsets of size numVertices + 1) with no room to
+  // spare
+  void Assign(std::vector<unsigned int> &&offsets, std::vector<E> &&list);
+  void Clear(void);
+  bool Empty(void) const;
+  BasicEdgeRange<E> Get(unsigned int u) const;
+
+  void Insert(unsigned int u, const E &e);
+  // First edge to @v in the list of @u, nullptr if there is none
+  E* Find(unsigned int u, unsigned int v);
+  // Same, among the edges of weight @weight
+  E* Find(unsigned int u, unsigned int v, double weight);
+  // Removes @e, found in the list of @u
+  void Erase(unsigned int u, E *e);
+
+  // Raw arrays, for Graph to iterate without going through Get()
+  const unsigned int* Begins(void) const;
+  const unsigned int* Ends(void) const;
+  const E* Edges(void) const;
+
+ private:
+  void Compact(void);
+
+  std::vector<unsigned int> begin, end, cap;
+  std::vector<E> edges;
+  size_t numLive = 0;
+};
+
+const char kGraphFileMagic[4] = {'E', 'W', 'D', 'B'};
+const uint32_t kGraphFileVersion = 1;
+const uint32_t kGraphFileByteOrder = 0x01020304;
+
+// Header of the binary graph format written by ewd_to_bin. It is followed
+// by the CSR offsets (numVertices + 1 x uint32), zero padding up to an
+// 8-byte boundary, and numEdges edge records laid out exactly like the
+// BasicEdge of the weight format (uint32 destination, then the weight at
+// the end of the record, zero padding in between), so the file can be
+// mapped and used in place.
+struct GraphFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t edgeSize;
+  uint32_t numVertices;
+  uint32_t weightFormat;  // kFileFormat of the weight policy
+  uint64_t numEdges;
+};
+
+// Graph stored in compressed sparse row (CSR) form: the out-edges of vertex
+// u are edges[offsets[u]] to edges[offsets[u + 1] - 1]. The arrays are
+// either owned (text input) or point into a read-only mapping of a binary
+// graph file. The first edit moves the graph to a BasicEditableAdjacency,
+// whose list ends no longer follow from the next offset, hence the ends
+// array. Edge weights are stored as @Weight says; see DoubleWeight.
+template <typename Weight>
+class BasicGraph {
+ public:
+  typedef BasicEdge<Weight> EdgeType;
+  typedef BasicEdgeRange<EdgeType> RangeType;
+
+  BasicGraph() = default;
+  BasicGraph(const BasicGraph &) = delete;
+  BasicGraph& operator=(const BasicGraph &) = delete;
+  ~BasicGraph();
+
+  // Load a binary graph file if @fileName has its magic number, or parse it
+  // as EWD text otherwise
+  int Load(const std::string &fileName);
+  int ExtractFile(const std::string &fileName);
+  int MapBinaryFile(const std::string &fileName);
+  int WriteBinaryFile(const std::string &fileName) const;
+
+  int GetNumVertices(void) const;
+  int GetNumEdges(void) const;
+  RangeType GetEdges(unsigned int u) const;
+  void Print(void) const;
+  // Hash of the edges of every vertex, dests and weights, in order. Index
+  // files store it to tell the graph they were built for.
+  uint64_t Checksum(void) const;
+
+  // In-place updates, in time proportional to the degrees involved. The
+  // reverse adjacency, if built, is kept in sync. With parallel edges, the
+  // first edge u -> v is the one deleted or changed.
+  // Return -1 on an invalid vertex or weight, or a missing edge
+  int InsertEdge(unsigned int u, unsigned int v, double weight);
+  int DeleteEdge(unsigned int u, unsigned int v);
+  int SetEdgeWeight(unsigned int u, unsigned int v, double weight);
+
+  // Renames every vertex u to newId[u], a permutation of the vertices. The
+  // edges of each vertex keep their order, and the reverse adjacency is
+  // dropped.
+  void Renumber(const std::vector<unsigned int> &newId);
+
+  // Copies @other, storing its weights as Weight does
+  // Returns -1 if a weight does not fit, 0 otherwise
+  template <typename W>
+  int CopyFrom(const BasicGraph<W> &other);
+
+  // Build the reverse adjacency, where the edge u -> v with weight w is
+  // stored as v -> u with weight w. Needed by backward searches.
+  void BuildReverse(void);
+  bool HasReverse(void) const;
+  RangeType GetReverseEdges(unsigned int u) const;
+
+  static bool IsBinaryFile(const std::string &fileName);
+
+ private:
+  // Chunk of EWD text, whose edges run in file order up to the first field
+  // that does not parse or the first invalid edge
+  struct TextChunk {
+    const char *begin, *end;
+    // Edges of each source vertex in the chunk, then where the next one
+    // goes in the edge array
+    std::vector<unsigned int> next;
+    bool stopped = false;
+    std::string error;      // Message of the first invalid edge, if any
+    int numLeftFields = 0;  // Fields of an edge cut off by the chunk end
+  };
+
+  // Parses the EWD text between @begin and @end in two passes over the
+  // same chunks: the first counts the edges of each vertex, the second
+  // writes each edge where it belongs in CSR arrays of the exact size
+  int ParseText(const char *begin, const char *end);
+  // Calls addEdges(sources, edges, n) for each batch of n edges of @chunk,
+  // and records how the chunk ended
+  template <typename AddEdges>
+  static void ParseChunk(int numVertices, TextChunk &chunk,
+                         AddEdges addEdges);
+  // Parses the edge at @p into @source and @edge. Returns false at the end
+  // of @chunk or at a field or edge that stops it.
+  static bool ParseEdge(int numVertices, const char *&p, TextChunk &chunk,
+                        unsigned int &source, EdgeType &edge);
+  // Runs task(c) for each of the first @numChunks chunks, a thread each
+  template <typename Task>
+  static void ForEachChunk(size_t numChunks, Task task);
+  void Unmap(void);
+  // Points ends at the CSR offsets, or all three arrays at @editable
+  void SetPointers(void);
+  // Moves the edges to @editable before the first update
+  void MakeEditable(void);
+  bool CheckEdge(unsigned int u, unsigned int v, double weight) const;
+  static uint64_t EdgesOffset(uint32_t numVertices);
+
+  int numVertices = 0;
+  int numEdges = 0;
+
+  const unsigned int *offsets = nullptr;
+  const unsigned int *ends = nullptr;
+  const EdgeType *edges = nullptr;
+
+  // Owned storage, empty when the graph is mapped from a file
+  std::vector<unsigned int> offsetStore;
+  std::vector<EdgeType> edgeStore;
+
+  // Out-edges once the graph has been edited
+  bool isEditable = false;
+  BasicEditableAdjacency<EdgeType> editable;
+
+  // Reverse adjacency, always owned
+  BasicEditableAdjacency<EdgeType> reverse;
+
+  void *mapAddr = nullptr;
+  size_t mapLength = 0;
+};
+
+// Weight storage of Graph and Edge, chosen at compile time with
+// -DGRAPH_WEIGHT=FloatWeight or FixedWeight
+#ifndef GRAPH_WEIGHT
+#define GRAPH_WEIGHT DoubleWeight
+#endif
+
+typedef BasicEdge<GRAPH_WEIGHT> Edge;
+typedef BasicEdgeRange<Edge> EdgeRange;
+typedef BasicGraph<GRAPH_WEIGHT> Graph;
+
+template <typename Weight>
+BasicEdge<Weight>::BasicEdge(unsigned int dest, double weight)
+    : edgeDestVertex(dest), weight(Weight::Encode(weight)) {}
+
+template <typename Weight>
+unsigned int BasicEdge<Weight>::GetEdgeDest(void) const {
+  return edgeDestVertex;
+}
+
+template <typename Weight>
+double BasicEdge<Weight>::GetWeight(void) const {
+  return Weight::Decode(weight);
+}
+
+template <typename W>
+std::ostream& operator <<(std::ostream &os, const BasicEdge<W> &e) {
+  os << "edgeDestVertex: " << e.edgeDestVertex << " ";
+  os << "edgeWeight: " << e.GetWeight();
+
+  return os;
+}
+
+template <typename E>
+void BasicEditableAdjacency<E>::Assign(std::vector<unsigned int> &&offsets,
+                                       std::vector<E> &&list) {
+  // begin keeps the extra entry so an empty graph is not Empty()
+  end.assign(offsets.begin() + 1, offsets.end());
+  cap = end;
+  begin = std::move(offsets);
+  edges = std::move(list);
+  numLive = edges.size();
+}
+
+template <typename E>
+void BasicEditableAdjacency<E>::Clear(void) {
+  begin.clear();
+  end.clear();
+  cap.clear();
+  edges.clear();
+  numLive = 0;
+}
+
+template <typename E>
+bool BasicEditableAdjacency<E>::Empty(void) const {
+  return begin.empty();
+}
+
+template <typename E>
+BasicEdgeRange<E> BasicEditableAdjacency<E>::Get(unsigned int u) const {
+  return BasicEdgeRange<E>(edges.data() + begin[u], edges.data() + end[u]);
+}
+
+template <typename E>
+void BasicEditableAdjacency<E>::Insert(unsigned int u, const E &e) {
+  if (end[u] == cap[u]) {
+    unsigned int degree = end[u] - begin[u];
+    unsigned int first = edges.size();
+
+    edges.resize(first + 2 * degree + 1);
+    std::copy(edges.begin() + begin[u], edges.begin() + end[u],
+              edges.begin() + first);
+    begin[u] = first;
+    end[u] = first + degree;
+    cap[u] = edges.size();
+  }
+  edges[end[u]++] = e;
+  numLive++;
+
+  // Slots of moved lists are lost until the next compaction
+  if (edges.size() > 4 * numLive + 64)
+    Compact();
+}
+
+template <typename E>
+E* BasicEditableAdjacency<E>::Find(unsigned int u, unsigned int v) {
+  for (unsigned int i = begin[u]; i < end[u]; i++) {
+    if (edges[i].GetEdgeDest() == v)
+      return &edges[i];
+  }
+  return nullptr;
+}
+
+template <typename E>
+E* BasicEditableAdjacency<E>::Find(unsigned int u, unsigned int v,
+                                   double weight) {
+  for (unsigned int i = begin[u]; i < end[u]; i++) {
+    if (edges[i].GetEdgeDest() == v && edges[i].GetWeight() == weight)
+      return &edges[i];
+  }
+  return nullptr;
+}
+
+// Order within a list is not kept: the last edge fills the hole
+template <typename E>
+void BasicEditableAdjacency<E>::Erase(unsigned int u, E *e) {
+  *e = edges[--end[u]];
+  numLive--;
+}
+
+// Every list gets as many free slots as edges, so vertices that were just
+// updated do not move again right away
+template <typename E>
+void BasicEditableAdjacency<E>::Compact(void) {
+  std::vector<E> packed;
+  packed.reserve(2 * numLive);
+
+  for (size_t u = 0; u < end.size(); u++) {
+    unsigned int first = packed.size();
+    packed.insert(packed.end(), edges.begin() + begin[u],
+                  edges.begin() + end[u]);
+    begin[u] = first;
+    end[u] = packed.size();
+    packed.resize(end[u] + (end[u] - first));
+    cap[u] = packed.size();
+  }
+  edges.swap(packed);
+}
+
+template <typename E>
+const unsigned int* BasicEditableAdjacency<E>::Begins(void) const {
+  return begin.data();
+}
+
+template <typename E>
+const unsigned int* BasicEditableAdjacency<E>::Ends(void) const {
+  return end.data();
+}
+
+template <typename E>
+const E* BasicEditableAdjacency<E>::Edges(void) const {
+  return edges.data();
+}
+
+template <typename Weight>
+BasicGraph<Weight>::~BasicGraph() {
+  Unmap();
+}
+
+template <typename Weight>
+void BasicGraph<Weight>::Unmap(void) {
+  if (mapAddr)
+    munmap(mapAddr, mapLength);
+  mapAddr = nullptr;
+  mapLength = 0;
+}
+
+template <typename Weight>
+bool BasicGraph<Weight>::IsBinaryFile(const std::string &fileName) {
+  std::ifstream myfile(fileName, std::ios::binary);
+  char magic[sizeof(kGraphFileMagic)];
+
+  if (!myfile.read(magic, sizeof(magic)))
+    return false;
+  return std::memcmp(magic, kGraphFileMagic, sizeof(kGraphFileMagic)) == 0;
+}
+
+template <typename Weight>
+int BasicGraph<Weight>::Load(const std::string &fileName) {
+  if (IsBinaryFile(fileName))
+    return MapBinaryFile(fileName);
+  return ExtractFile(fileName);
+}
+
+// Extracts file contents to construct graph. The file is mapped and its
+// edges parsed by one thread per chunk; the result and the errors are the
+// same as reading the file with >> from the start. Only the final arrays
+// and an edge count per vertex and chunk are allocated, not the edge list.
+// Returns -1 if file cannot be open or there are input errors
+// Returns 0 if file successfully read
+template <typename Weight>
+int BasicGraph<Weight>::ExtractFile(const std::string &fileName) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  // Regular files are mapped, anything else like a pipe is read in full
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  std::string text;
+  const char *begin;
+  if (addr != MAP_FAILED) {
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    begin = static_cast<const char *>(addr);
+  } else {
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+      text.append(buffer, n);
+    begin = text.data();
+  }
+  close(fd);
+
+  const char *end = addr != MAP_FAILED ? begin + st.st_size
+                                       : begin + text.size();
+  int status = ParseText(begin, end);
+  if (addr != MAP_FAILED)
+    munmap(addr, st.st_size);
+  return status;
+}
+
+template <typename Weight>
+int BasicGraph<Weight>::ParseText(const char *begin, const char *end) {
+  // Chunks of at least this many bytes get a thread each
+  const size_t kMinChunkBytes = 256 << 10;
+  // Short EWD lines, for a low guess of the number of edges
+  const size_t kBytesPerEdge = 16;
+  const char *p = SkipTextSpace(begin, end);
+
+  if (!ParseIntField(p, end, numVertices) || numVertices < 0) {
+    // There are no vertices in the graph
+    std::cerr << "Error: invalid graph size" << std::endl;
+    return -1;
+  }
+
+  // Each chunk counts edges for every vertex, so there are only as many
+  // as fit in about a tenth of the guessed size of the graph. Sparse
+  // graphs with many vertices are parsed by fewer threads.
+  size_t countBytes = sizeof(unsigned int) * (numVertices + 1);
+  size_t graphBytes = (end - p) / kBytesPerEdge * sizeof(EdgeType)
+      + countBytes;
+  size_t numChunks = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()),
+      (end - p) / kMinChunkBytes + 1);
+  numChunks = std::max<size_t>(
+      1, std::min(numChunks, graphBytes / 10 / countBytes));
+
+  // Chunks are cut after a newline, so each starts with a whole edge as
+  // long as edges do not span lines
+  std::vector<TextChunk> chunks(numChunks);
+  chunks[0].begin = p;
+  for (size_t i = 1; i < numChunks; i++) {
+    const char *cut = std::max(p + (end - p) * i / numChunks,
+                               chunks[i - 1].begin);
+    const char *newline = static_cast<const char *>(
+        std::memchr(cut, '\n', end - cut));
+    chunks[i].begin = newline ? newline + 1 : end;
+    chunks[i - 1].end = chunks[i].begin;
+  }
+  chunks.back().end = end;
+
+  auto countEdges = [this, &chunks](size_t c) {
+    TextChunk &chunk = chunks[c];
+    chunk.next.assign(numVertices, 0);
+    ParseChunk(numVertices, chunk,
+               [&chunk](const unsigned int *sources, const EdgeType *,
+                        size_t n) {
+                 for (size_t i = 0; i < n; i++)
+                   chunk.next[sources[i]]++;
+               });
+  };
+  ForEachChunk(numChunks, countEdges);
+
+  // An edge split over two chunks leaves the later chunks out of step, so
+  // the text is parsed again in one piece
+  for (size_t i = 0; i + 1 < chunks.size() && !chunks[i].stopped; i++) {
+    if (chunks[i].numLeftFields) {
+      chunks.resize(1);
+      chunks[0] = TextChunk();
+      chunks[0].begin = p;
+      chunks[0].end = end;
+      countEdges(0);
+      break;
+    }
+  }
+
+  // Reading stops at the first chunk that stopped, as >> would have
+  size_t numUsed = 0;
+  while (numUsed < chunks.size()) {
+    const TextChunk &chunk = chunks[numUsed++];
+    if (!chunk.error.empty()) {
+      std::cerr << chunk.error << std::endl;
+      return -1;
+    }
+    if (chunk.stopped)
+      break;
+  }
+  chunks.resize(numUsed);
+
+  Unmap();
+  reverse.Clear();
+  isEditable = false;
+  editable.Clear();
+
+  // Edges of vertex u go in file order: those of the first chunk from
+  // offsets[u], then those of the next chunk, and so on
+  offsetStore.assign(numVertices + 1, 0);
+  for (int u = 0; u < numVertices; u++) {
+    unsigned int next = offsetStore[u];
+    for (TextChunk &chunk : chunks) {
+      unsigned int count = chunk.next[u];
+      chunk.next[u] = next;
+      next += count;
+    }
+    offsetStore[u + 1] = next;
+  }
+  numEdges = numVertices ? offsetStore[numVertices] : 0;
+
+  // Edges of an earlier load are freed first, not kept until the swap
+  std::vector<EdgeType>().swap(edgeStore);
+  edgeStore.resize(numEdges);
+  ForEachChunk(numUsed, [this, &chunks](size_t c) {
+    TextChunk &chunk = chunks[c];
+    EdgeType *out = edgeStore.data();
+    ParseChunk(numVertices, chunk,
+               [&chunk, out](const unsigned int *sources,
+                             const EdgeType *batch, size_t n) {
+                 for (size_t i = 0; i < n; i++)
+                   out[chunk.next[sources[i]]++] = batch[i];
+               });
+  });
+
+  offsets = offsetStore.data();
+  edges = edgeStore.data();
+  SetPointers();
+  return 0;
+}
+
+// Edges go to addEdges in batches, so that the random accesses it makes
+// overlap each other instead of each waiting behind the parsing
+template <typename Weight>
+template <typename AddEdges>
+void BasicGraph<Weight>::ParseChunk(int numVertices, TextChunk &chunk,
+                                    AddEdges addEdges) {
+  const size_t kBatchEdges = 1024;
+  unsigned int sources[kBatchEdges];
+  EdgeType batch[kBatchEdges];
+  const char *p = chunk.begin;
+  size_t n = 0;
+
+  while (ParseEdge(numVertices, p, chunk, sources[n], batch[n])) {
+    if (++n == kBatchEdges) {
+      addEdges(sources, batch, n);
+      n = 0;
+    }
+  }
+  addEdges(sources, batch, n);
+}
+
+template <typename Weight>
+bool BasicGraph<Weight>::ParseEdge(int numVertices, const char *&p,
+                                   TextChunk &chunk, unsigned int &source,
+                                   EdgeType &edge) {
+  const char *end = chunk.end;
+  unsigned int edgeDestVertex = 0;
+  double edgeWeight = 0;
+
+  for (int field = 0; field < 3; field++) {
+    p = SkipTextSpace(p, end);
+    if (p == end) {
+      chunk.numLeftFields = field;
+      return false;
+    }
+    bool parsed = field == 0 ? ParseUnsignedField(p, end, source)
+        : field == 1 ? ParseUnsignedField(p, end, edgeDestVertex)
+        : ParseDoubleField(p, end, edgeWeight);
+    if (!parsed) {
+      chunk.stopped = true;
+      return false;
+    }
+  }
+
+  bool validSource = source < static_cast<unsigned int>(numVertices);
+  bool validDest = edgeDestVertex < static_cast<unsigned int>(numVertices);
+  if (!validSource || !validDest || edgeWeight < 0
+      || !Weight::Fits(edgeWeight)) {
+    std::ostringstream error;
+    if (!validSource)
+      error << "Invalid source vertex number " << source;
+    else if (!validDest)
+      error << "Invalid dest vertex number " << edgeDestVertex;
+    else
+      error << "Invalid weight " << edgeWeight;
+    chunk.error = error.str();
+    chunk.stopped = true;
+    return false;
+  }
+
+  edge = EdgeType(edgeDestVertex, edgeWeight);
+  return true;
+}
+
+template <typename Weight>
+template <typename Task>
+void BasicGraph<Weight>::ForEachChunk(size_t numChunks, Task task) {
+  std::vector<std::thread> threads;
+  for (size_t c = 1; c < numChunks; c++)
+    threads.emplace_back(task, c);
+  if (numChunks)
+    task(0);
+  for (std::thread &t : threads)
+    t.join();
+}
+
+template <typename Weight>
+void BasicGraph<Weight>::SetPointers(void) {
+  if (isEditable) {
+    offsets = editable.Begins();
+    ends = editable.Ends();
+    edges = editable.Edges();
+  } else {
+    ends = offsets + 1;
+  }
+}
+
+template <typename Weight>
+uint64_t BasicGraph<Weight>::EdgesOffset(uint32_t numVertices) {
+  uint64_t end = sizeof(GraphFileHeader)
+      + (static_cast<uint64_t>(numVertices) + 1) * sizeof(uint32_t);
+  return (end + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Maps a binary graph file read-only and uses its arrays in place
+// Returns -1 if file cannot be open or is not a valid graph file
+// Returns 0 if file successfully mapped
+template <typename Weight>
+int BasicGraph<Weight>::MapBinaryFile(const std::string &fileName) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0
+      || st.st_size < static_cast<off_t>(sizeof(GraphFileHeader))) {
+    std::cerr << "Error: invalid graph file " << fileName << std::endl;
+    close(fd);
+    return -1;
+  }
+
+  void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "Error: cannot map file " << fileName << std::endl;
+    return -1;
+  }
+
+  const char *base = static_cast<const char *>(addr);
+  GraphFileHeader header;
+  std::memcpy(&header, base, sizeof(header));
+
+  // The offsets array is checked in full since everything else relies on
+  // it, then every edge in one pass, as the text loader would check them
+  bool valid = std::memcmp(header.magic, kGraphFileMagic,
+                           sizeof(kGraphFileMagic)) == 0
+      && header.version == kGraphFileVersion
+      && header.byteOrder == kGraphFileByteOrder;
+  if (valid && (header.weightFormat != Weight::kFileFormat
+                || header.edgeSize != sizeof(EdgeType))) {
+    std::cerr << "Error: graph file " << fileName << " stores weights in"
+              << " format " << header.weightFormat << ", not "
+              << Weight::kFileFormat << std::endl;
+    munmap(addr, st.st_size);
+    return -1;
+  }
+  valid = valid
+      && header.numVertices <= static_cast<uint32_t>(INT32_MAX)
+      && header.numEdges <= static_cast<uint64_t>(INT32_MAX)
+      && static_cast<uint64_t>(st.st_size) == EdgesOffset(header.numVertices)
+          + header.numEdges * sizeof(EdgeType);
+  const unsigned int *fileOffsets = reinterpret_cast<const unsigned int *>(
+      base + sizeof(GraphFileHeader));
+  if (valid) {
+    valid = fileOffsets[0] == 0
+        && fileOffsets[header.numVertices] == header.numEdges;
+    for (uint32_t u = 0; valid && u < header.numVertices; u++)
+      valid = fileOffsets[u] <= fileOffsets[u + 1];
+  }
+  const EdgeType *fileEdges = reinterpret_cast<const EdgeType *>(
+      base + EdgesOffset(header.numVertices));
+  for (uint64_t i = 0; valid && i < header.numEdges; i++) {
+    // Also false for a NaN weight
+    valid = fileEdges[i].GetEdgeDest() < header.numVertices
+        && fileEdges[i].GetWeight() >= 0;
+  }
+  if (!valid) {
+    std::cerr << "Error: invalid graph file " << fileName << std::endl;
+    munmap(addr, st.st_size);
+    return -1;
+  }
+
+  Unmap();
+  offsetStore.clear();
+  edgeStore.clear();
+  isEditable = false;
+  editable.Clear();
+  reverse.Clear();
+  mapAddr = addr;
+  mapLength = st.st_size;
+
+  numVertices = header.numVertices;
+  numEdges = header.numEdges;
+  offsets = fileOffsets;
+  edges = fileEdges;
+  SetPointers();
+
+  return 0;
+}
+
+// Writes the graph in the binary format read by MapBinaryFile()
+// Returns -1 if file cannot be written, 0 otherwise
+template <typename Weight>
+int BasicGraph<Weight>::WriteBinaryFile(const std::string &fileName) const {
+  std::ofstream myfile(fileName, std::ios::binary | std::ios::trunc);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  GraphFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kGraphFileMagic, sizeof(kGraphFileMagic));
+  header.version = kGraphFileVersion;
+  header.byteOrder = kGraphFileByteOrder;
+  header.edgeSize = sizeof(EdgeType);
+  header.numVertices = numVertices;
+  header.weightFormat = Weight::kFileFormat;
+  header.numEdges = numEdges;
+  myfile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  // Offsets are recomputed from the degrees, since an edited graph has
+  // gaps between its lists
+  uint32_t offset = 0;
+  myfile.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  for (int u = 0; u < numVertices; u++) {
+    offset += GetEdges(u).size();
+    myfile.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  }
+  uint64_t written = sizeof(header) + (numVertices + 1) * sizeof(uint32_t);
+  const char padding[8] = {0};
+  myfile.write(padding, EdgesOffset(numVertices) - written);
+
+  // Records are written field by field so the padding bytes are zero
+  for (int u = 0; u < numVertices; u++) {
+    for (const EdgeType &e : GetEdges(u)) {
+      char record[sizeof(EdgeType)] = {0};
+      uint32_t dest = e.GetEdgeDest();
+      typename Weight::Stored weight = Weight::Encode(e.GetWeight());
+      std::memcpy(record, &dest, sizeof(dest));
+      std::memcpy(record + sizeof(EdgeType) - sizeof(weight), &weight,
+                  sizeof(weight));
+      myfile.write(record, sizeof(record));
+    }
+  }
+
+  if (!myfile) {
+    std::cerr << "Error: cannot write file " << fileName << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+template <typename Weight>
+int BasicGraph<Weight>::GetNumVertices(void) const {
+  return numVertices;
+}
+
+template <typename Weight>
+int BasicGraph<Weight>::GetNumEdges(void) const {
+  return numEdges;
+}
+
+template <typename Weight>
+typename BasicGraph<Weight>::RangeType BasicGraph<Weight>::GetEdges(
+    unsigned int u) const {
+  return RangeType(edges + offsets[u], edges + ends[u]);
+}
+
+// FNV-1a over 64-bit words: the degree of each vertex, then the dest and
+// the bits of the weight of each of its edges
+template <typename Weight>
+uint64_t BasicGraph<Weight>::Checksum(void) const {
+  const uint64_t kPrime = 1099511628211ull;
+  uint64_t hash = 14695981039346656037ull;
+
+  for (int u = 0; u < numVertices; u++) {
+    RangeType range = GetEdges(u);
+    hash = (hash ^ range.size()) * kPrime;
+    for (const EdgeType &e : range) {
+      double weight = e.GetWeight();
+      uint64_t bits;
+      std::memcpy(&bits, &weight, sizeof(bits));
+      hash = (hash ^ e.GetEdgeDest()) * kPrime;
+      hash = (hash ^ bits) * kPrime;
+    }
+  }
+  return hash;
+}
+
+template <typename Weight>
+void BasicGraph<Weight>::BuildReverse(void) {
+  std::vector<unsigned int> reverseOffsets(numVertices + 1, 0);
+  for (int u = 0; u < numVertices; u++) {
+    for (const EdgeType &e : GetEdges(u))
+      reverseOffsets[e.GetEdgeDest() + 1]++;
+  }
+  for (int u = 0; u < numVertices; u++)
+    reverseOffsets[u + 1] += reverseOffsets[u];
+
+  std::vector<unsigned int> next(reverseOffsets.begin(),
+                                 reverseOffsets.end() - 1);
+  std::vector<EdgeType> reverseEdges(numEdges);
+  for (int u = 0; u < numVertices; u++) {
+    for (const EdgeType &e : GetEdges(u))
+      reverseEdges[next[e.GetEdgeDest()]++] = EdgeType(u, e.GetWeight());
+  }
+  reverse.Assign(std::move(reverseOffsets), std::move(reverseEdges));
+}
+
+template <typename Weight>
+bool BasicGraph<Weight>::HasReverse(void) const {
+  return !reverse.Empty();
+}
+
+template <typename Weight>
+typename BasicGraph<Weight>::RangeType BasicGraph<Weight>::GetReverseEdges(
+    unsigned int u) const {
+  return reverse.Get(u);
+}
+
+template <typename Weight>
+void BasicGraph<Weight>::MakeEditable(void) {
+  if (isEditable)
+    return;
+
+  std::vector<unsigned int> csrOffsets(offsets, offsets + numVertices + 1);
+  std::vector<EdgeType> csrEdges(edges, edges + numEdges);
+  editable.Assign(std::move(csrOffsets), std::move(csrEdges));
+
+  Unmap();
+  offsetStore.clear();
+  edgeStore.clear();
+  isEditable = true;
+  SetPointers();
+}
+
+template <typename Weight>
+bool BasicGraph<Weight>::CheckEdge(unsigned int u, unsigned int v,
+                                   double weight) const {
+  if (u >= static_cast<unsigned int>(numVertices)
+      || v >= static_cast<unsigned int>(numVertices)) {
+    std::cerr << "Error: invalid edge " << u << " -> " << v << std::endl;
+    return false;
+  }
+  if (weight < 0 || !Weight::Fits(weight)) {
+    std::cerr << "Error: invalid weight " << weight << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template <typename Weight>
+int BasicGraph<Weight>::InsertEdge(unsigned int u, unsigned int v,
+                                   double weight) {
+  if (!CheckEdge(u, v, weight))
+    return -1;
+
+  MakeEditable();
+  editable.Insert(u, EdgeType(v, weight));
+  if (HasReverse())
+    reverse.Insert(v, EdgeType(u, weight));
+  numEdges++;
+  SetPointers();
+  return 0;
+}
+
+template <typename Weight>
+int BasicGraph<Weight>::DeleteEdge(unsigned int u, unsigned int v) {
+  if (!CheckEdge(u, v, 0))
+    return -1;
+
+  MakeEditable();
+  EdgeType *e = editable.Find(u, v);
+  if (!e) {
+    std::cerr << "Error: no edge " << u << " -> " << v << std::endl;
+    return -1;
+  }
+  if (HasReverse())
+    reverse.Erase(v, reverse.Find(v, u, e->GetWeight()));
+  editable.Erase(u, e);
+  numEdges--;
+  return 0;
+}
+
+// The reverse copy may belong to another parallel edge of the same
+// weight, which leaves the reverse adjacency the same
+template <typename Weight>
+int BasicGraph<Weight>::SetEdgeWeight(unsigned int u, unsigned int v,
+                                      double weight) {
+  if (!CheckEdge(u, v, weight))
+    return -1;
+
+  MakeEditable();
+  EdgeType *e = editable.Find(u, v);
+  if (!e) {
+    std::cerr << "Error: no edge " << u << " -> " << v << std::endl;
+    return -1;
+  }
+  if (HasReverse())
+    *reverse.Find(v, u, e->GetWeight()) = EdgeType(u, weight);
+  *e = EdgeType(v, weight);
+  return 0;
+}
+
+template <typename Weight>
+void BasicGraph<Weight>::Renumber(const std::vector<unsigned int> &newId) {
+  std::vector<unsigned int> oldId(numVertices);
+  for (int u = 0; u < numVertices; u++)
+    oldId[newId[u]] = u;
+
+  std::vector<unsigned int> newOffsets(numVertices + 1, 0);
+  std::vector<EdgeType> newEdges;
+  newEdges.reserve(numEdges);
+  for (int x = 0; x < numVertices; x++) {
+    for (const EdgeType &e : GetEdges(oldId[x]))
+      newEdges.push_back(EdgeType(newId[e.GetEdgeDest()], e.GetWeight()));
+    newOffsets[x + 1] = newEdges.size();
+  }
+
+  Unmap();
+  reverse.Clear();
+  isEditable = false;
+  editable.Clear();
+  offsetStore.swap(newOffsets);
+  edgeStore.swap(newEdges);
+  offsets = offsetStore.data();
+  edges = edgeStore.data();
+  SetPointers();
+}
+
+template <typename Weight>
+template <typename W>
+int BasicGraph<Weight>::CopyFrom(const BasicGraph<W> &other) {
+  std::vector<unsigned int> newOffsets(other.GetNumVertices() + 1, 0);
+  std::vector<EdgeType> newEdges;
+  newEdges.reserve(other.GetNumEdges());
+  for (int u = 0; u < other.GetNumVertices(); u++) {
+    for (const BasicEdge<W> &e : other.GetEdges(u)) {
+      if (!Weight::Fits(e.GetWeight())) {
+        std::cerr << "Error: invalid weight " << e.GetWeight() << std::endl;
+        return -1;
+      }
+      newEdges.push_back(EdgeType(e.GetEdgeDest(), e.GetWeight()));
+    }
+    newOffsets[u + 1] = newEdges.size();
+  }
+
+  Unmap();
+  reverse.Clear();
+  isEditable = false;
+  editable.Clear();
+  numVertices = other.GetNumVertices();
+  numEdges = other.GetNumEdges();
+  offsetStore.swap(newOffsets);
+  edgeStore.swap(newEdges);
+  offsets = offsetStore.data();
+  edges = edgeStore.data();
+  SetPointers();
+  return 0;
+}
+
+template <typename Weight>
+void BasicGraph<Weight>::Print(void) const {
+  for (int u = 0; u < numVertices; u++) {
+    std::cout << "At vertex " << u << ", adjacent edges are:" << std::endl;
+    for (const EdgeType &edge : GetEdges(u))
+      std::cout << edge << std::endl;
+    std::cout << std::endl;
+  }
+}
+
+#endif  // GRAPH_H_
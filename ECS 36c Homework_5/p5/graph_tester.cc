@@ -0,0 +1,227 @@
+#include <unistd.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compressed_graph.h"
+#include "graph.h"
+
+// Scratch files go in the current directory, named after the process
+const std::string kScratch = "graph_tester." + std::to_string(getpid());
+
+void WriteFile(const std::string &fileName, const std::string &contents) {
+  std::ofstream myfile(fileName, std::ios::binary | std::ios::trunc);
+  myfile << contents;
+}
+
+std::string ReadFile(const std::string &fileName) {
+  std::ifstream myfile(fileName, std::ios::binary);
+  std::ostringstream contents;
+  contents << myfile.rdbuf();
+  return contents.str();
+}
+
+// Loads @contents as a graph file, with the error messages of Load() kept
+// off the output
+// Returns what Load() returns
+template <typename G>
+int LoadText(G &g, const std::string &contents) {
+  WriteFile(kScratch, contents);
+  std::ostringstream errors;
+  std::streambuf *saved = std::cerr.rdbuf(errors.rdbuf());
+  int status = g.Load(kScratch);
+  std::cerr.rdbuf(saved);
+  std::remove(kScratch.c_str());
+  return status;
+}
+
+// Edges of @g as "u v w" lines, in the order GetEdges() returns them
+std::string EdgeList(const Graph &g) {
+  std::ostringstream os;
+  for (int u = 0; u < g.GetNumVertices(); u++) {
+    for (const Edge &e : g.GetEdges(u))
+      os << u << ' ' << e.GetEdgeDest() << ' ' << e.GetWeight() << '\n';
+  }
+  return os.str();
+}
+
+// Tester
+int main() {
+  int failures = 0;
+  Graph g;
+
+  // Well-formed text, parsed in one chunk
+  int status = LoadText(g, "3\n0 1 0.5\n1 2 0.25\n0 2 1\n");
+  bool loaded = status == 0 && g.GetNumVertices() == 3
+      && g.GetNumEdges() == 3
+      && EdgeList(g) == "0 1 0.5\n0 2 1\n1 2 0.25\n";
+  // Small graph loaded= 1
+  std::cout << "Small graph loaded= " << loaded << std::endl;
+  failures += !loaded;
+
+  // Reading stops at the first field that does not parse, like >> does,
+  // an overflowing weight included
+  status = LoadText(g, "3\n0 1 0.5\n1 2 x\n0 2 1\n");
+  bool stopped = status == 0 && g.GetNumEdges() == 1;
+  status = LoadText(g, "3\n0 1 0.5\n1 2 1e999\n0 2 1\n");
+  stopped = stopped && status == 0 && g.GetNumEdges() == 1;
+  // Stopped at bad field= 1
+  std::cout << "Stopped at bad field= " << stopped << std::endl;
+  failures += !stopped;
+
+  // Each malformed input should be rejected
+  const char *malformed[] = {
+    "",                    // No size
+    "x\n0 1 1\n",          // Size is not a number
+    "-3\n0 1 1\n",         // Negative size
+    "3\n0 3 1\n",          // Dest out of range
+    "3\n3 0 1\n",          // Source out of range
+    "3\n0 -1 1\n",         // Dest wraps around to a large vertex
+    "3\n0 1 -0.5\n",       // Negative weight
+  };
+  int numRejected = 0;
+  for (const char *text : malformed)
+    numRejected += LoadText(g, text) == -1;
+  // Malformed inputs rejected= 7
+  std::cout << "Malformed inputs rejected= " << numRejected << std::endl;
+  failures += numRejected != sizeof(malformed) / sizeof(malformed[0]);
+
+  // A file large enough for a chunk per thread, with edges of the same
+  // vertex spread over all of them, loads in file order
+  std::mt19937 rng(1);
+  const int kNumVertices = 1000;
+  std::ostringstream text;
+  std::vector<std::ostringstream> lists(kNumVertices);
+  text << kNumVertices << '\n';
+  for (int i = 0; i < 200000; i++) {
+    unsigned int u = rng() % kNumVertices, v = rng() % kNumVertices;
+    double w = rng() % 1000 / 8.0;
+    text << u << ' ' << v << ' ' << w << '\n';
+    lists[u] << u << ' ' << v << ' ' << w << '\n';
+  }
+  std::string expected;
+  for (std::ostringstream &list : lists)
+    expected += list.str();
+  status = LoadText(g, text.str());
+  bool chunked = status == 0 && EdgeList(g) == expected;
+  // Large graph loaded in order= 1
+  std::cout << "Large graph loaded in order= " << chunked << std::endl;
+  failures += !chunked;
+
+  // An invalid edge near the end is still found
+  status = LoadText(g, text.str() + "0 1000 1\n");
+  // Invalid last edge rejected= 1
+  std::cout << "Invalid last edge rejected= " << (status == -1) << std::endl;
+  failures += status != -1;
+
+  // Binary round trip: the mapped graph has the same edges
+  Graph textGraph, mapped;
+  LoadText(textGraph, text.str());
+  std::string binFile = kScratch + ".bin";
+  textGraph.WriteBinaryFile(binFile);
+  std::string binary = ReadFile(binFile);
+  bool mappedSame = Graph::IsBinaryFile(binFile)
+      && mapped.Load(binFile) == 0
+      && mapped.GetNumEdges() == textGraph.GetNumEdges()
+      && mapped.Checksum() == textGraph.Checksum();
+  std::remove(binFile.c_str());
+  // Binary graph mapped= 1
+  std::cout << "Binary graph mapped= " << mappedSame << std::endl;
+  failures += !mappedSame;
+
+  // Damaged binary files should be rejected: the header is followed by the
+  // 1001 offsets of the vertex lists
+  std::vector<std::string> damaged;
+  damaged.push_back(binary.substr(0, binary.size() - 1));  // Truncated
+  damaged.push_back(binary + '\0');                        // Trailing byte
+  damaged.push_back(binary.substr(0, 20));                 // Header cut
+  std::string copy = binary;
+  copy[4] = 9;                                            // Version
+  damaged.push_back(copy);
+  copy = binary;
+  copy[sizeof(GraphFileHeader) + 4 * 500 + 3] = 0x7f;     // Offsets order
+  damaged.push_back(copy);
+  numRejected = 0;
+  for (const std::string &file : damaged)
+    numRejected += LoadText(g, file) == -1;
+  // Damaged binary files rejected= 5
+  std::cout << "Damaged binary files rejected= " << numRejected
+            << std::endl;
+  failures += numRejected != static_cast<int>(damaged.size());
+
+  // An edge with a dest out of range, or with a weight the text loader
+  // rejects, makes the file invalid. Only some weight storages can hold a
+  // negative or NaN weight.
+  std::vector<Edge> badEdges;
+  badEdges.push_back(Edge(0x7fffff00, 1));
+  for (double weight : {-0.5, std::nan("")}) {
+    if (!(Edge(0, weight).GetWeight() >= 0))
+      badEdges.push_back(Edge(0, weight));
+  }
+  size_t edgeAt = binary.size() - 1234 * sizeof(Edge);
+  numRejected = 0;
+  for (const Edge &e : badEdges) {
+    copy = binary;
+    copy.replace(edgeAt, sizeof(Edge), reinterpret_cast<const char *>(&e),
+                 sizeof(Edge));
+    numRejected += LoadText(g, copy) == -1;
+  }
+  bool badEdgesRejected = numRejected == static_cast<int>(badEdges.size());
+  // Bad edges rejected= 1
+  std::cout << "Bad edges rejected= " << badEdgesRejected << std::endl;
+  failures += !badEdgesRejected;
+
+  // Without the magic number the file is read as text, and fails there
+  copy = binary;
+  copy[0] = 'X';
+  status = LoadText(g, copy);
+  // Bad magic rejected= 1
+  std::cout << "Bad magic rejected= " << (status == -1) << std::endl;
+  failures += status != -1;
+
+  // A compressed file must decode within each vertex's bytes to vertices
+  // of the graph, and to as many edges as its header says
+  CompressedGraph compressed, loadedCompressed;
+  compressed.Build(textGraph);
+  std::string zFile = kScratch + ".z";
+  compressed.WriteFile(zFile);
+  std::string packed = ReadFile(zFile);
+  std::remove(zFile.c_str());
+  bool compressedSame = LoadText(loadedCompressed, packed) == 0;
+  size_t listsAt = sizeof(CompressedFileHeader)
+      + (kNumVertices + 1) * sizeof(uint64_t);
+  uint64_t firstListEnd;
+  std::memcpy(&firstListEnd,
+              packed.data() + sizeof(CompressedFileHeader) + sizeof(uint64_t),
+              sizeof(firstListEnd));
+  damaged.clear();
+  copy = packed;
+  copy[listsAt] = 3;                                   // Dest of -2
+  damaged.push_back(copy);
+  copy = packed;
+  copy[listsAt + firstListEnd - 1] |= 0x80;            // Varint runs on
+  damaged.push_back(copy);
+  copy = packed;
+  copy[offsetof(CompressedFileHeader, numEdges)] ^= 1;  // Edge count
+  damaged.push_back(copy);
+  numRejected = 0;
+  for (const std::string &file : damaged)
+    numRejected += LoadText(compressed, file) == -1;
+  compressedSame = compressedSame
+      && numRejected == static_cast<int>(damaged.size());
+  // Damaged compressed files rejected= 1
+  std::cout << "Damaged compressed files rejected= " << compressedSame
+            << std::endl;
+  failures += !compressedSame;
+
+  return failures ? 1 : 0;
+}
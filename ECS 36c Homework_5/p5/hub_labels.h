@@ -0,0 +1,353 @@
+#ifndef HUB_LABELS_H_
+#define HUB_LABELS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "dijkstra.h"
+#include "graph.h"
+
+const char kHubFileMagic[4] = {'E', 'W', 'D', 'H'};
+const uint32_t kHubFileVersion = 2;
+
+// Header of a hub label file. It is followed by the out-label and in-label
+// offsets (numVertices + 1 x uint64 each), then the out-label hubs
+// (numOut x uint32), the in-label hubs (numIn x uint32), the out-label
+// distances (numOut doubles) and the in-label distances (numIn doubles),
+// in host byte order. @numEdges and @checksum are those of the graph it
+// was built for (see Graph::Checksum()).
+struct HubFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t numVertices;
+  uint32_t reserved;
+  uint64_t numOut;
+  uint64_t numIn;
+  uint64_t numEdges;
+  uint64_t checksum;
+};
+
+// 2-hop hub labels built by pruned landmark labeling (Akiba, Iwata and
+// Yoshida). Every vertex v has an out-label of hubs it reaches, with
+// d(v, hub), and an in-label of hubs reaching it, with d(hub, v), such
+// that some shortest path from s to t goes through a hub of both the
+// out-label of s and the in-label of t. A distance is then a merge of two
+// short sorted arrays, with no search at all. Hubs are numbered by rank,
+// so labels are sorted by construction.
+class HubLabels {
+ public:
+  // Processes the vertices by decreasing importance, running a forward and
+  // a backward Dijkstra from each that stops at vertices the labels built
+  // so far already cover. Needs the reverse adjacency of @g.
+  void Build(const Graph &g);
+  int Save(const std::string &fileName) const;
+  // Returns -1 if the file is invalid or was built for another graph
+  int Load(const std::string &fileName, const Graph &g);
+
+  // Distance from @s to @t, max() if @t is unreachable
+  double Distance(unsigned int s, unsigned int t) const;
+  // Exact distance, as a lower bound for AStar
+  double LowerBound(unsigned int v, unsigned int t) const;
+  // Mean number of entries of a label
+  double GetAverageLabelSize(void) const;
+
+ private:
+  // Vertices by decreasing importance: the number of vertices below them
+  // in sampled forward and backward shortest path trees, then degree.
+  // Hubs that cover many paths early keep the later labels short; on
+  // 10000EWD this halves the label size that degree alone gives.
+  static std::vector<unsigned int> RankVertices(const Graph &g);
+  // Search from the vertex of rank @rank for Build(). The forward search
+  // adds to the in-labels of the vertices it reaches, the backward one
+  // (with @reverse) to their out-labels.
+  void PrunedSearch(const Graph &g, unsigned int source, unsigned int rank,
+                    bool reverse, DijkstraWorkspace &ws,
+                    std::vector<double> &hubDist);
+
+  int numVertices = 0;
+  // Label of v: hubs[offsets[v]] to hubs[offsets[v + 1] - 1], with the
+  // matching dist entries
+  std::vector<uint64_t> outOffsets, inOffsets;
+  std::vector<uint32_t> outHubs, inHubs;
+  std::vector<double> outDist, inDist;
+  uint64_t numGraphEdges = 0, graphChecksum = 0;  // Of the graph built for
+
+  // Labels while they grow during Build()
+  std::vector<std::vector<uint32_t>> buildHubs[2];
+  std::vector<std::vector<double>> buildDist[2];
+};
+
+inline void HubLabels::Build(const Graph &g) {
+  numVertices = g.GetNumVertices();
+  numGraphEdges = g.GetNumEdges();
+  graphChecksum = g.Checksum();
+
+  std::vector<unsigned int> order = RankVertices(g);
+
+  for (int side = 0; side < 2; side++) {
+    buildHubs[side].assign(numVertices, std::vector<uint32_t>());
+    buildDist[side].assign(numVertices, std::vector<double>());
+  }
+
+  // hubDist[rank] holds the label of the current source while it searches
+  DijkstraWorkspace ws(numVertices);
+  std::vector<double> hubDist(numVertices,
+                              std::numeric_limits<double>::max());
+  for (int rank = 0; rank < numVertices; rank++) {
+    PrunedSearch(g, order[rank], rank, false, ws, hubDist);
+    PrunedSearch(g, order[rank], rank, true, ws, hubDist);
+  }
+
+  // Packs the labels, side 0 being the out-labels
+  std::vector<uint64_t> *offsets[2] = {&outOffsets, &inOffsets};
+  std::vector<uint32_t> *hubs[2] = {&outHubs, &inHubs};
+  std::vector<double> *dist[2] = {&outDist, &inDist};
+  for (int side = 0; side < 2; side++) {
+    offsets[side]->assign(1, 0);
+    hubs[side]->clear();
+    dist[side]->clear();
+    for (int v = 0; v < numVertices; v++) {
+      hubs[side]->insert(hubs[side]->end(), buildHubs[side][v].begin(),
+                         buildHubs[side][v].end());
+      dist[side]->insert(dist[side]->end(), buildDist[side][v].begin(),
+                         buildDist[side][v].end());
+      offsets[side]->push_back(hubs[side]->size());
+    }
+    buildHubs[side].clear();
+    buildDist[side].clear();
+  }
+}
+
+inline std::vector<unsigned int> HubLabels::RankVertices(const Graph &g) {
+  const int kNumSamples = 128;
+  int numVertices = g.GetNumVertices();
+  int numSamples = std::min(numVertices, kNumSamples);
+  std::vector<double> cover(numVertices, 0);
+  std::vector<double> below(numVertices);
+  std::vector<unsigned int> settled;
+  DijkstraWorkspace ws(numVertices);
+
+  for (int i = 0; i < numSamples; i++) {
+    unsigned int source = static_cast<uint64_t>(i) * numVertices / numSamples;
+
+    for (int reverse = 0; reverse < 2; reverse++) {
+      settled.clear();
+      SearchAdjacency([&g, reverse](unsigned int u) {
+                        return reverse ? g.GetReverseEdges(u) : g.GetEdges(u);
+                      },
+                      [&settled](unsigned int u) {
+                        settled.push_back(u);
+                        return false;
+                      },
+                      source, ws);
+
+      // Vertices settle after their parent, so a backward sweep sums the
+      // subtrees
+      for (unsigned int u : settled)
+        below[u] = 1;
+      for (size_t j = settled.size() - 1; j > 0; j--)
+        below[ws.GetPrev(settled[j])] += below[settled[j]];
+      for (unsigned int u : settled)
+        cover[u] += below[u];
+    }
+  }
+
+  std::vector<unsigned int> order(numVertices);
+  for (int v = 0; v < numVertices; v++)
+    order[v] = v;
+  std::stable_sort(order.begin(), order.end(),
+                   [&g, &cover](unsigned int a, unsigned int b) {
+                     if (cover[a] != cover[b])
+                       return cover[a] > cover[b];
+                     return g.GetEdges(a).size() + g.GetReverseEdges(a).size()
+                         > g.GetEdges(b).size() + g.GetReverseEdges(b).size();
+                   });
+  return order;
+}
+
+inline void HubLabels::PrunedSearch(const Graph &g, unsigned int source,
+                                    unsigned int rank, bool reverse,
+                                    DijkstraWorkspace &ws,
+                                    std::vector<double> &hubDist) {
+  // A forward search checks the out-label of the source against the
+  // in-labels it reaches, a backward one the other way around
+  int own = reverse ? 1 : 0;
+  int other = 1 - own;
+  std::vector<uint32_t> &sourceHubs = buildHubs[own][source];
+  for (size_t i = 0; i < sourceHubs.size(); i++)
+    hubDist[sourceHubs[i]] = buildDist[own][source][i];
+
+  IndexMinPQ<double> &Q = ws.GetQueue();
+  ws.NewQuery();
+  ws.Update(source, 0, -1);
+  Q.Push(0, source);
+
+  while (Q.Size()) {
+    unsigned int u = Q.Top();
+    Q.Pop();
+    double distU = ws.GetDist(u);
+
+    // Covered by a hub of higher rank: so is everything behind u
+    const std::vector<uint32_t> &hubs = buildHubs[other][u];
+    const std::vector<double> &dist = buildDist[other][u];
+    bool covered = false;
+    for (size_t i = 0; i < hubs.size() && !covered; i++)
+      covered = hubDist[hubs[i]] + dist[i] <= distU;
+    if (covered)
+      continue;
+
+    buildHubs[other][u].push_back(rank);
+    buildDist[other][u].push_back(distU);
+
+    EdgeRange edges = reverse ? g.GetReverseEdges(u) : g.GetEdges(u);
+    for (const Edge &e : edges) {
+      unsigned int v = e.GetEdgeDest();
+      double alt = distU + e.GetWeight();
+      if (alt < ws.GetDist(v)) {
+        ws.Update(v, alt, u);
+
+        if (Q.Contains(v))
+          Q.ChangeKey(alt, v);
+        else
+          Q.Push(alt, v);
+      }
+    }
+  }
+
+  for (uint32_t hub : sourceHubs)
+    hubDist[hub] = std::numeric_limits<double>::max();
+}
+
+inline int HubLabels::Save(const std::string &fileName) const {
+  std::ofstream myfile(fileName, std::ios::binary | std::ios::trunc);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  HubFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kHubFileMagic, sizeof(kHubFileMagic));
+  header.version = kHubFileVersion;
+  header.numVertices = numVertices;
+  header.numOut = outHubs.size();
+  header.numIn = inHubs.size();
+  header.numEdges = numGraphEdges;
+  header.checksum = graphChecksum;
+
+  myfile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  myfile.write(reinterpret_cast<const char *>(outOffsets.data()),
+               outOffsets.size() * sizeof(uint64_t));
+  myfile.write(reinterpret_cast<const char *>(inOffsets.data()),
+               inOffsets.size() * sizeof(uint64_t));
+  myfile.write(reinterpret_cast<const char *>(outHubs.data()),
+               outHubs.size() * sizeof(uint32_t));
+  myfile.write(reinterpret_cast<const char *>(inHubs.data()),
+               inHubs.size() * sizeof(uint32_t));
+  myfile.write(reinterpret_cast<const char *>(outDist.data()),
+               outDist.size() * sizeof(double));
+  myfile.write(reinterpret_cast<const char *>(inDist.data()),
+               inDist.size() * sizeof(double));
+
+  if (!myfile) {
+    std::cerr << "Error: cannot write file " << fileName << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+inline int HubLabels::Load(const std::string &fileName, const Graph &g) {
+  std::ifstream myfile(fileName, std::ios::binary);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  HubFileHeader header;
+  if (!myfile.read(reinterpret_cast<char *>(&header), sizeof(header))
+      || std::memcmp(header.magic, kHubFileMagic, sizeof(kHubFileMagic)) != 0
+      || header.version != kHubFileVersion) {
+    std::cerr << "Error: invalid hub label file " << fileName << std::endl;
+    return -1;
+  }
+  if (header.numVertices != static_cast<uint32_t>(g.GetNumVertices())
+      || header.numEdges != static_cast<uint64_t>(g.GetNumEdges())
+      || header.checksum != g.Checksum()) {
+    std::cerr << "Error: hub label file " << fileName
+              << " does not match the graph" << std::endl;
+    return -1;
+  }
+
+  numVertices = header.numVertices;
+  outOffsets.resize(numVertices + 1);
+  inOffsets.resize(numVertices + 1);
+  outHubs.resize(header.numOut);
+  inHubs.resize(header.numIn);
+  outDist.resize(header.numOut);
+  inDist.resize(header.numIn);
+
+  myfile.read(reinterpret_cast<char *>(outOffsets.data()),
+              outOffsets.size() * sizeof(uint64_t));
+  myfile.read(reinterpret_cast<char *>(inOffsets.data()),
+              inOffsets.size() * sizeof(uint64_t));
+  myfile.read(reinterpret_cast<char *>(outHubs.data()),
+              outHubs.size() * sizeof(uint32_t));
+  myfile.read(reinterpret_cast<char *>(inHubs.data()),
+              inHubs.size() * sizeof(uint32_t));
+  myfile.read(reinterpret_cast<char *>(outDist.data()),
+              outDist.size() * sizeof(double));
+  myfile.read(reinterpret_cast<char *>(inDist.data()),
+              inDist.size() * sizeof(double));
+
+  // Queries index the arrays through the offsets, so those are checked
+  bool valid = static_cast<bool>(myfile) && outOffsets[0] == 0
+      && inOffsets[0] == 0 && outOffsets[numVertices] == header.numOut
+      && inOffsets[numVertices] == header.numIn;
+  for (int v = 0; valid && v < numVertices; v++) {
+    valid = outOffsets[v] <= outOffsets[v + 1]
+        && inOffsets[v] <= inOffsets[v + 1];
+  }
+  if (!valid) {
+    std::cerr << "Error: invalid hub label file " << fileName << std::endl;
+    return -1;
+  }
+  numGraphEdges = header.numEdges;
+  graphChecksum = header.checksum;
+  return 0;
+}
+
+inline double HubLabels::Distance(unsigned int s, unsigned int t) const {
+  uint64_t i = outOffsets[s], iEnd = outOffsets[s + 1];
+  uint64_t j = inOffsets[t], jEnd = inOffsets[t + 1];
+  double best = std::numeric_limits<double>::max();
+
+  // Branch-free steps, the comparisons of a merge being unpredictable
+  while (i < iEnd && j < jEnd) {
+    uint32_t a = outHubs[i], b = inHubs[j];
+    if (a == b)
+      best = std::min(best, outDist[i] + inDist[j]);
+    i += a <= b;
+    j += b <= a;
+  }
+  return best;
+}
+
+inline double HubLabels::LowerBound(unsigned int v, unsigned int t) const {
+  return Distance(v, t);
+}
+
+inline double HubLabels::GetAverageLabelSize(void) const {
+  if (!numVertices)
+    return 0;
+  return (outHubs.size() + inHubs.size()) / (2.0 * numVertices);
+}
+
+#endif  // HUB_LABELS_H_
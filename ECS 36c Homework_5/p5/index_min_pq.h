@@ -6,8 +6,21 @@
 #include <utility>
 #include <vector>
 
-template <typename K>
+#include "search_stats.h"
+
+// Children of each heap node unless given to IndexMinPQ, 4 being the
+// fastest for Dijkstra on the p5 graphs. Set with e.g. make HEAP_ARITY=2.
+#ifndef INDEX_MIN_PQ_ARITY
+#define INDEX_MIN_PQ_ARITY 4
+#endif
+
+// Indexed min heap whose nodes have @D children each. A larger @D makes
+// the heap shallower, so ChangeKey and Push move an item up fewer levels,
+// while Pop compares more children on each level down.
+template <typename K, unsigned int D = INDEX_MIN_PQ_ARITY>
 class IndexMinPQ {
+  static_assert(D >= 2, "a heap node needs at least two children");
+
  public:
   // Constructor with max number of indexes
   explicit IndexMinPQ(int capacity);
@@ -23,6 +36,12 @@ class IndexMinPQ {
   bool Contains(unsigned int idx);
   // Change key associated to index @idx
   void ChangeKey(const K &key, unsigned int idx);
+  // Remove all items, in time proportional to the current size
+  void Clear();
+#ifdef SEARCH_STATS
+  // Operation counts and heap depth since the last Clear()
+  QueueStats GetStats() const;
+#endif
 
  private:
   // Private members
@@ -31,19 +50,22 @@ class IndexMinPQ {
   std::vector<K> keys;
   std::vector<unsigned int> heap_to_idx;
   std::vector<unsigned int> idx_to_heap;
+#ifdef SEARCH_STATS
+  QueueStats stats;
+  unsigned int max_size = 0;
+#endif
 
   // Helper methods for indices
   unsigned int Root() {
     return 1;
   }
+  // Children of node i are FirstChild(i) to FirstChild(i) + D - 1, so
+  // with D = 2 they are 2i and 2i + 1
   unsigned int Parent(unsigned int i) {
-    return i / 2;
-  }
-  unsigned int LeftChild(unsigned int i) {
-    return 2 * i;
+    return (i - 2) / D + 1;
   }
-  unsigned int RightChild(unsigned int i) {
-    return 2 * i + 1;
+  unsigned int FirstChild(unsigned int i) {
+    return D * (i - 1) + 2;
   }
 
   // Helper methods for node testing
@@ -58,6 +80,19 @@ class IndexMinPQ {
     // otherwise
     return (keys[heap_to_idx[i]] > keys[heap_to_idx[j]]);
   }
+  // Return the smallest child of node i, or 0 if it has none
+  unsigned int MinChild(unsigned int i) {
+    unsigned int first = FirstChild(i);
+    if (!IsNode(first))
+      return 0;
+    unsigned int last = std::min(first + D - 1, cur_size);
+    unsigned int child = first;
+    for (unsigned int j = first + 1; j <= last; j++) {
+      if (GreaterNode(child, j))
+        child = j;
+    }
+    return child;
+  }
 
   // Helper methods for restructuring
   void SwapNodes(unsigned int i, unsigned int j) {
@@ -85,13 +120,13 @@ class IndexMinPQ {
          << keys[heap_to_idx[i]] << ")";
       throw std::runtime_error(ss.str());
     }
-    CheckHeapOrder(LeftChild(i));
-    CheckHeapOrder(RightChild(i));
+    for (unsigned int j = 0; j < D; j++)
+      CheckHeapOrder(FirstChild(i) + j);
   }
 };
 
-template <typename K>
-IndexMinPQ<K>::IndexMinPQ(int capacity)
+template <typename K, unsigned int D>
+IndexMinPQ<K, D>::IndexMinPQ(int capacity)
     : capacity(capacity),
       keys(capacity),
       heap_to_idx(capacity + 1),
@@ -99,13 +134,13 @@ IndexMinPQ<K>::IndexMinPQ(int capacity)
   cur_size = 0;
 }
 
-template <typename K>
-unsigned int IndexMinPQ<K>::Size() {
+template <typename K, unsigned int D>
+unsigned int IndexMinPQ<K, D>::Size() {
   return cur_size;
 }
 
-template <typename K>
-unsigned int IndexMinPQ<K>::Top(void) {
+template <typename K, unsigned int D>
+unsigned int IndexMinPQ<K, D>::Top(void) {
   if (!Size())
     throw std::underflow_error("Priority queue underflow!");
 
@@ -114,16 +149,16 @@ unsigned int IndexMinPQ<K>::Top(void) {
   return heap_to_idx[Root()];
 }
 
-template <typename K>
-void IndexMinPQ<K>::PercolateUp(unsigned int i) {
+template <typename K, unsigned int D>
+void IndexMinPQ<K, D>::PercolateUp(unsigned int i) {
   while (HasParent(i) && GreaterNode(Parent(i), i)) {
     SwapNodes(Parent(i), i);
     i = Parent(i);
   }
 }
 
-template <typename K>
-void IndexMinPQ<K>::Push(const K &key, unsigned int idx) {
+template <typename K, unsigned int D>
+void IndexMinPQ<K, D>::Push(const K &key, unsigned int idx) {
   if (idx >= capacity)
     throw std::overflow_error("Index invalid!");
   if (Contains(idx))
@@ -139,19 +174,20 @@ void IndexMinPQ<K>::Push(const K &key, unsigned int idx) {
   idx_to_heap[heap_to_idx[cur_size]] = cur_size;
   keys[idx] = key;
   PercolateUp(cur_size);
+#ifdef SEARCH_STATS
+  stats.numPushes++;
+  max_size = std::max(max_size, cur_size);
+#endif
   // CheckHeapOrder(cur_size);
 }
 
-template <typename K>
-void IndexMinPQ<K>::PercolateDown(unsigned int i) {
-  // While node has at least one child (if one, necessarily on the left)
-  while (IsNode(LeftChild(i))) {
-    // Find smallest children between left and right if any
-    unsigned int child = LeftChild(i);
-    if (IsNode(RightChild(i)) && GreaterNode(LeftChild(i), RightChild(i)))
-      child = RightChild(i);
-
-    // Exchange node with child to restore heap-order if necessary
+template <typename K, unsigned int D>
+void IndexMinPQ<K, D>::PercolateDown(unsigned int i) {
+  // While node has at least one child (its children are packed from the
+  // first one)
+  while (unsigned int child = MinChild(i)) {
+    // Exchange node with its smallest child to restore heap-order if
+    // necessary
     if (GreaterNode(i, child))
       SwapNodes(i, child);
     else
@@ -162,8 +198,8 @@ void IndexMinPQ<K>::PercolateDown(unsigned int i) {
   }
 }
 
-template <typename K>
-void IndexMinPQ<K>::Pop() {
+template <typename K, unsigned int D>
+void IndexMinPQ<K, D>::Pop() {
   if (!Size())
     throw std::underflow_error("Empty priority queue!");
 
@@ -174,19 +210,25 @@ void IndexMinPQ<K>::Pop() {
   // (for debugging, check heap order)
   idx_to_heap[heap_to_idx[Root()]] = 0;
   heap_to_idx[Root()] = std::move(heap_to_idx[cur_size--]);
+  // The last item now sits at the root, even if it does not move down
+  if (Size())
+    idx_to_heap[heap_to_idx[Root()]] = Root();
   PercolateDown(Root());
+#ifdef SEARCH_STATS
+  stats.numPops++;
+#endif
   // CheckHeapOrder(cur_size);
 }
 
-template <typename K>
-bool IndexMinPQ<K>::Contains(unsigned int idx) {
+template <typename K, unsigned int D>
+bool IndexMinPQ<K, D>::Contains(unsigned int idx) {
   if (idx >= capacity)
     throw std::overflow_error("Index invalid!");
   return (idx_to_heap[idx] != 0);
 }
 
-template <typename K>
-void IndexMinPQ<K>::ChangeKey(const K &key, unsigned int idx) {
+template <typename K, unsigned int D>
+void IndexMinPQ<K, D>::ChangeKey(const K &key, unsigned int idx) {
   if (idx >= capacity)
     throw std::overflow_error("Index invalid!");
   if (!Contains(idx))
@@ -198,15 +240,48 @@ void IndexMinPQ<K>::ChangeKey(const K &key, unsigned int idx) {
   //  - Note that key might be have increased _or_ decreased
   // (for debugging, check heap order)
   keys[idx] = key;
-  if ((IsNode(LeftChild(idx_to_heap[idx])) && GreaterNode(idx_to_heap[idx],
-      LeftChild(idx_to_heap[idx]))) || (IsNode(RightChild(idx_to_heap[idx]))
-      && GreaterNode(idx_to_heap[idx], RightChild(idx_to_heap[idx])))) {
+  unsigned int child = MinChild(idx_to_heap[idx]);
+  if (child && GreaterNode(idx_to_heap[idx], child)) {
     PercolateDown(idx_to_heap[idx]);
   } else if (HasParent(idx_to_heap[idx])
         && GreaterNode(Parent(idx_to_heap[idx]), idx_to_heap[idx])) {
       PercolateUp(idx_to_heap[idx]);
   }
+#ifdef SEARCH_STATS
+  stats.numChangeKeys++;
+#endif
   // CheckHeapOrder(cur_size);
 }
 
+template <typename K, unsigned int D>
+void IndexMinPQ<K, D>::Clear() {
+  // Only the indexes still in the heap have a valid mapping to reset
+  for (unsigned int i = Root(); i <= cur_size; i++)
+    idx_to_heap[heap_to_idx[i]] = 0;
+  cur_size = 0;
+#ifdef SEARCH_STATS
+  stats = QueueStats();
+  max_size = 0;
+#endif
+}
+
+#ifdef SEARCH_STATS
+template <typename K, unsigned int D>
+QueueStats IndexMinPQ<K, D>::GetStats() const {
+  // Levels of a D-ary heap of n nodes: the first holds 1 node, and each
+  // next one D times as many as the one above
+  QueueStats result = stats;
+  for (uint64_t full = 0, level = 1; full < max_size; level *= D) {
+    full += level;
+    result.maxDepth++;
+  }
+  return result;
+}
+
+template <typename K, unsigned int D>
+QueueStats GetQueueStats(const IndexMinPQ<K, D> &q) {
+  return q.GetStats();
+}
+#endif
+
 #endif  // INDEX_MIN_PQ_H_
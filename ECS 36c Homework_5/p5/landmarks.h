@@ -0,0 +1,231 @@
+#ifndef LANDMARKS_H_
+#define LANDMARKS_H_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "dijkstra.h"
+#include "graph.h"
+
+const char kLandmarkFileMagic[4] = {'E', 'W', 'D', 'L'};
+const uint32_t kLandmarkFileVersion = 2;
+const double kLandmarkInfinity = std::numeric_limits<double>::max();
+
+// Header of a landmark file. It is followed by the landmark ids
+// (numLandmarks x uint32) and the two distance tables (numVertices x
+// numLandmarks doubles each), in host byte order. @numEdges and @checksum
+// are those of the graph it was built for (see Graph::Checksum()).
+struct LandmarkFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t numVertices;
+  uint32_t numLandmarks;
+  uint64_t numEdges;
+  uint64_t checksum;
+};
+
+// Distance tables for A* search with landmark lower bounds (ALT). For each
+// landmark L they hold d(L, v) and d(v, L), and the triangle inequality
+// gives d(v, t) >= d(L, t) - d(L, v) and d(v, t) >= d(v, L) - d(t, L).
+// Tables are stored vertex-major so one lower bound reads k contiguous
+// entries.
+class Landmarks {
+ public:
+  // Picks up to @k landmarks by farthest selection and runs a full
+  // Dijkstra from and to each of them. Needs the reverse adjacency of @g.
+  void Build(const Graph &g, int k);
+  int Save(const std::string &fileName) const;
+  // Returns -1 if the file is invalid or was built for another graph
+  int Load(const std::string &fileName, const Graph &g);
+
+  int GetNumLandmarks(void) const;
+  const std::vector<unsigned int>& GetLandmarks(void) const;
+  // Lower bound on the distance from @v to @t
+  double LowerBound(unsigned int v, unsigned int t) const;
+
+ private:
+  int numVertices = 0;
+  std::vector<unsigned int> landmarks;
+  // d(landmarks[i], v) at [v * k + i], kLandmarkInfinity if unreachable
+  std::vector<double> fromLandmark;
+  // d(v, landmarks[i]) at [v * k + i], kLandmarkInfinity if unreachable
+  std::vector<double> toLandmark;
+  uint64_t numGraphEdges = 0, graphChecksum = 0;  // Of the graph built for
+};
+
+inline void Landmarks::Build(const Graph &g, int k) {
+  DijkstraWorkspace ws(g.GetNumVertices());
+  numVertices = g.GetNumVertices();
+  numGraphEdges = g.GetNumEdges();
+  graphChecksum = g.Checksum();
+  landmarks.clear();
+
+  // Farthest selection: the first landmark is the vertex farthest from
+  // vertex 0, every next one the vertex farthest from the landmarks picked
+  // so far. @closest is that distance, infinite while unreached; unreached
+  // vertices are skipped since they would only help their own component.
+  std::vector<double> closest(numVertices, kLandmarkInfinity);
+  std::vector<bool> chosen(numVertices, false);
+  std::vector<std::vector<double>> from, to;
+
+  if (numVertices > 0) {
+    RunDijkstra(g, 0, -1, false, ws);
+    for (int v = 0; v < numVertices; v++)
+      closest[v] = ws.GetDist(v);
+  }
+
+  while (static_cast<int>(landmarks.size()) < k) {
+    int next = -1;
+    double farthest = -1;
+    for (int v = 0; v < numVertices; v++) {
+      if (!chosen[v] && closest[v] != kLandmarkInfinity
+          && closest[v] > farthest) {
+        next = v;
+        farthest = closest[v];
+      }
+    }
+    if (next == -1)
+      break;
+
+    landmarks.push_back(next);
+    chosen[next] = true;
+
+    RunDijkstra(g, next, -1, true, ws);
+    to.push_back(std::vector<double>(numVertices));
+    for (int v = 0; v < numVertices; v++)
+      to.back()[v] = ws.GetDist(v);
+
+    RunDijkstra(g, next, -1, false, ws);
+    from.push_back(std::vector<double>(numVertices));
+    for (int v = 0; v < numVertices; v++) {
+      from.back()[v] = ws.GetDist(v);
+      if (landmarks.size() == 1)
+        closest[v] = ws.GetDist(v);
+      else
+        closest[v] = std::min(closest[v], ws.GetDist(v));
+    }
+  }
+
+  unsigned int numLandmarks = landmarks.size();
+  fromLandmark.resize(static_cast<size_t>(numVertices) * numLandmarks);
+  toLandmark.resize(fromLandmark.size());
+  for (int v = 0; v < numVertices; v++) {
+    size_t row = static_cast<size_t>(v) * numLandmarks;
+    for (unsigned int i = 0; i < numLandmarks; i++) {
+      fromLandmark[row + i] = from[i][v];
+      toLandmark[row + i] = to[i][v];
+    }
+  }
+}
+
+inline int Landmarks::Save(const std::string &fileName) const {
+  std::ofstream myfile(fileName, std::ios::binary | std::ios::trunc);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  LandmarkFileHeader header;
+  std::memcpy(header.magic, kLandmarkFileMagic, sizeof(kLandmarkFileMagic));
+  header.version = kLandmarkFileVersion;
+  header.numVertices = numVertices;
+  header.numLandmarks = landmarks.size();
+  header.numEdges = numGraphEdges;
+  header.checksum = graphChecksum;
+
+  myfile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  myfile.write(reinterpret_cast<const char *>(landmarks.data()),
+               landmarks.size() * sizeof(unsigned int));
+  myfile.write(reinterpret_cast<const char *>(fromLandmark.data()),
+               fromLandmark.size() * sizeof(double));
+  myfile.write(reinterpret_cast<const char *>(toLandmark.data()),
+               toLandmark.size() * sizeof(double));
+
+  if (!myfile) {
+    std::cerr << "Error: cannot write file " << fileName << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+inline int Landmarks::Load(const std::string &fileName, const Graph &g) {
+  std::ifstream myfile(fileName, std::ios::binary);
+
+  if (myfile.fail()) {
+    std::cerr << "Error: cannot open file " << fileName << std::endl;
+    return -1;
+  }
+
+  LandmarkFileHeader header;
+  if (!myfile.read(reinterpret_cast<char *>(&header), sizeof(header))
+      || std::memcmp(header.magic, kLandmarkFileMagic,
+                     sizeof(kLandmarkFileMagic)) != 0
+      || header.version != kLandmarkFileVersion) {
+    std::cerr << "Error: invalid landmark file " << fileName << std::endl;
+    return -1;
+  }
+  if (header.numVertices != static_cast<uint32_t>(g.GetNumVertices())
+      || header.numEdges != static_cast<uint64_t>(g.GetNumEdges())
+      || header.checksum != g.Checksum()) {
+    std::cerr << "Error: landmark file " << fileName
+              << " does not match the graph" << std::endl;
+    return -1;
+  }
+
+  numVertices = header.numVertices;
+  landmarks.resize(header.numLandmarks);
+  fromLandmark.resize(static_cast<size_t>(numVertices) * landmarks.size());
+  toLandmark.resize(fromLandmark.size());
+
+  myfile.read(reinterpret_cast<char *>(landmarks.data()),
+              landmarks.size() * sizeof(unsigned int));
+  myfile.read(reinterpret_cast<char *>(fromLandmark.data()),
+              fromLandmark.size() * sizeof(double));
+  myfile.read(reinterpret_cast<char *>(toLandmark.data()),
+              toLandmark.size() * sizeof(double));
+
+  bool valid = static_cast<bool>(myfile);
+  for (size_t i = 0; valid && i < landmarks.size(); i++)
+    valid = landmarks[i] < header.numVertices;
+  if (!valid) {
+    std::cerr << "Error: invalid landmark file " << fileName << std::endl;
+    return -1;
+  }
+  numGraphEdges = header.numEdges;
+  graphChecksum = header.checksum;
+  return 0;
+}
+
+inline int Landmarks::GetNumLandmarks(void) const {
+  return landmarks.size();
+}
+
+inline const std::vector<unsigned int>& Landmarks::GetLandmarks(void) const {
+  return landmarks;
+}
+
+inline double Landmarks::LowerBound(unsigned int v, unsigned int t) const {
+  unsigned int k = landmarks.size();
+  const double *fromV = fromLandmark.data() + static_cast<size_t>(v) * k;
+  const double *fromT = fromLandmark.data() + static_cast<size_t>(t) * k;
+  const double *toV = toLandmark.data() + static_cast<size_t>(v) * k;
+  const double *toT = toLandmark.data() + static_cast<size_t>(t) * k;
+  double bound = 0;
+
+  // Unreachable entries carry no information and are skipped
+  for (unsigned int i = 0; i < k; i++) {
+    if (fromT[i] != kLandmarkInfinity && fromV[i] != kLandmarkInfinity)
+      bound = std::max(bound, fromT[i] - fromV[i]);
+    if (toV[i] != kLandmarkInfinity && toT[i] != kLandmarkInfinity)
+      bound = std::max(bound, toV[i] - toT[i]);
+  }
+  return bound;
+}
+
+#endif  // LANDMARKS_H_
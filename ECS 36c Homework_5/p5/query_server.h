@@ -0,0 +1,600 @@
+#ifndef QUERY_SERVER_H_
+#define QUERY_SERVER_H_
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Protocol of QueryServer. A connection carries "src dst" text lines,
+// each answered by one line in the format of the batch mode (blank lines
+// are skipped), unless its first 4 bytes are kQueryBinaryMagic. It then
+// carries QueryRequest records, each answered by a QueryAnswer record
+// followed by the path from the source to the destination (numVertices x
+// uint32), in host byte order. Either way requests may be pipelined, and
+// answers come back in request order.
+const char kQueryBinaryMagic[4] = {'E', 'W', 'D', 'Q'};
+
+struct QueryRequest {
+  uint32_t src;
+  uint32_t dst;
+};
+
+enum QueryStatus : uint32_t { kQueryFound, kQueryNoPath, kQueryInvalid };
+
+struct QueryAnswer {
+  uint32_t status;
+  uint32_t numVertices;
+  double distance;
+};
+
+// Path found for one query
+struct QueryResult {
+  double distance = std::numeric_limits<double>::max();
+  // From the destination back to the source, as ShortestPath::GetPath(),
+  // empty if there is no path
+  std::vector<int> path;
+};
+
+// Answers the query from its first to its second argument, on the worker
+// thread whose index is the third
+typedef std::function<void(unsigned int, unsigned int, unsigned int,
+                           QueryResult &)> QueryHandler;
+
+// Long-running query server on a UNIX domain socket. One thread multiplexes
+// all connections with epoll and hands their requests to a pool of workers,
+// which call the handler and wake it up through an eventfd once answers
+// are ready. A connection with too many requests in flight, or too many
+// answer bytes its client has not read yet, is not read until they drain.
+class QueryServer {
+ public:
+  QueryServer(int numVertices, int numWorkers, QueryHandler handler);
+  ~QueryServer();
+  QueryServer(const QueryServer &) = delete;
+  QueryServer& operator=(const QueryServer &) = delete;
+
+  // Listens on @socketPath, replacing a socket file no server answers on
+  // Returns -1 on error, 0 otherwise
+  int Listen(const std::string &socketPath);
+  // Serves until SIGINT or SIGTERM, then removes the socket file
+  // Returns -1 on error, 0 otherwise
+  int Run(void);
+
+ private:
+  struct Connection {
+    int fd;
+    bool binary = false;
+    bool protocolKnown = false;
+    bool eof = false;  // The client sends no more requests
+    uint32_t events = 0;  // Registered with epoll
+    std::string in;
+    size_t inPos = 0;  // Start of the unparsed requests in @in
+    uint64_t nextSeq = 0;  // Number of the next request
+    uint64_t nextOut = 0;  // Number of the next answer to send
+    std::map<uint64_t, std::string> ready;  // Answers ahead of nextOut
+    std::string out;
+    size_t outPos = 0;  // Start of the unsent bytes of @out
+  };
+  struct Job {
+    uint64_t conn;
+    uint64_t seq;
+    uint32_t src, dst;
+    bool valid;
+    bool binary;
+  };
+  struct Done {
+    uint64_t conn;
+    uint64_t seq;
+    std::string bytes;
+  };
+
+  // epoll keys of the fds besides the connections, whose keys are their
+  // ids
+  static const uint64_t kListenKey = 0, kWakeKey = 1, kSignalKey = 2;
+  static const uint64_t kMaxInFlight = 4096;  // Requests per connection
+  static const size_t kMaxUnsent = 1 << 20;  // Answer bytes per connection
+  static const size_t kReadSize = 64 << 10;
+
+  void Worker(unsigned int t);
+  static void Format(const Job &job, const QueryResult &result,
+                     std::string &bytes);
+  void Accept(void);
+  // Reads from @c and queues its complete requests
+  // Returns false if the connection failed
+  bool Receive(Connection &c);
+  void Parse(uint64_t id, Connection &c);
+  // Parses the text line @line of @c into @job
+  void ParseLine(const char *line, size_t length, Job &job) const;
+  // Hands the answers of the workers to their connections
+  void Collect(void);
+  // Returns false if the connection failed
+  bool Send(Connection &c);
+  // Returns whether @c may take more requests
+  static bool HasRoom(const Connection &c);
+  // Closes @id if it is done or failed, else updates its epoll events
+  void Update(uint64_t id, bool failed);
+  void Close(uint64_t id);
+  void Shutdown(void);
+
+  int numVertices;
+  int numWorkers;
+  QueryHandler handler;
+  std::string socketPath;
+  int listenFd = -1, epollFd = -1, wakeFd = -1, signalFd = -1;
+  sigset_t oldMask;
+  bool masked = false;  // oldMask holds the mask to restore
+
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+  uint64_t nextId = kSignalKey + 1;
+  uint64_t numServed = 0, numAccepted = 0;
+
+  std::vector<std::thread> workers;
+  std::mutex jobMutex;
+  std::condition_variable jobReady;
+  std::deque<Job> jobs;
+  std::vector<Job> newJobs;  // Parsed, not yet handed to the workers
+  bool stopping = false;
+  std::mutex doneMutex;
+  std::vector<Done> done;
+};
+
+inline QueryServer::QueryServer(int numVertices, int numWorkers,
+                                QueryHandler handler)
+    : numVertices(numVertices), numWorkers(numWorkers),
+      handler(std::move(handler)) {}
+
+inline QueryServer::~QueryServer() {
+  Shutdown();
+}
+
+inline int QueryServer::Listen(const std::string &socketPath) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Error: socket path " << socketPath << " is too long"
+              << std::endl;
+    return -1;
+  }
+  std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size());
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd < 0) {
+    std::cerr << "Error: cannot create socket" << std::endl;
+    return -1;
+  }
+
+  // A socket file nobody accepts on is left over from a dead server
+  struct stat st;
+  if (stat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool alive = probe >= 0
+        && connect(probe, reinterpret_cast<sockaddr *>(&addr),
+                   sizeof(addr)) == 0;
+    if (probe >= 0)
+      close(probe);
+    if (alive) {
+      std::cerr << "Error: a server already listens on " << socketPath
+                << std::endl;
+      return -1;
+    }
+    unlink(socketPath.c_str());
+  }
+
+  if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0
+      || listen(listenFd, SOMAXCONN) < 0) {
+    std::cerr << "Error: cannot listen on " << socketPath << ": "
+              << std::strerror(errno) << std::endl;
+    return -1;
+  }
+  this->socketPath = socketPath;
+  return 0;
+}
+
+inline int QueryServer::Run(void) {
+  // Signals are read from a signalfd; the workers inherit the mask
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+  masked = true;
+
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (listenFd < 0 || epollFd < 0 || wakeFd < 0 || signalFd < 0) {
+    std::cerr << "Error: cannot set up the server" << std::endl;
+    return -1;
+  }
+  int fds[3] = {listenFd, wakeFd, signalFd};
+  uint64_t keys[3] = {kListenKey, kWakeKey, kSignalKey};
+  for (int i = 0; i < 3; i++) {
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = keys[i];
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fds[i], &ev);
+  }
+
+  for (int t = 0; t < numWorkers; t++)
+    workers.push_back(std::thread(&QueryServer::Worker, this, t));
+  std::cerr << "Listening on " << socketPath << std::endl;
+
+  const int kMaxEvents = 64;
+  epoll_event events[kMaxEvents];
+  bool running = true;
+  while (running) {
+    int n = epoll_wait(epollFd, events, kMaxEvents, -1);
+    if (n < 0 && errno != EINTR) {
+      std::cerr << "Error: epoll_wait failed" << std::endl;
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      uint64_t key = events[i].data.u64;
+      if (key == kListenKey) {
+        Accept();
+      } else if (key == kWakeKey) {
+        Collect();
+      } else if (key == kSignalKey) {
+        // Consumed, or it would still be pending when the mask is restored
+        signalfd_siginfo info;
+        if (read(signalFd, &info, sizeof(info)) == sizeof(info))
+          running = false;
+      } else {
+        auto it = connections.find(key);
+        if (it == connections.end())
+          continue;
+        Connection &c = *it->second;
+        bool failed = false;
+        if (events[i].events & EPOLLIN)
+          failed = !Receive(c);
+        else if (events[i].events & (EPOLLERR | EPOLLHUP))
+          failed = true;
+        if (!failed && (events[i].events & EPOLLOUT))
+          failed = !Send(c);
+        if (!failed)
+          Parse(key, c);
+        Update(key, failed);
+      }
+    }
+
+    // Requests of every connection read in this round, under one lock
+    if (!newJobs.empty()) {
+      std::lock_guard<std::mutex> lock(jobMutex);
+      jobs.insert(jobs.end(), newJobs.begin(), newJobs.end());
+      newJobs.clear();
+      jobReady.notify_all();
+    }
+  }
+
+  std::cerr << "Served " << numServed << " queries on " << numAccepted
+            << " connections" << std::endl;
+  Shutdown();
+  return 0;
+}
+
+inline void QueryServer::Shutdown(void) {
+  {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    stopping = true;
+    jobs.clear();
+  }
+  jobReady.notify_all();
+  for (std::thread &t : workers)
+    t.join();
+  workers.clear();
+
+  while (!connections.empty())
+    Close(connections.begin()->first);
+  int *fds[4] = {&listenFd, &epollFd, &wakeFd, &signalFd};
+  for (int *fd : fds) {
+    if (*fd >= 0)
+      close(*fd);
+    *fd = -1;
+  }
+  if (!socketPath.empty())
+    unlink(socketPath.c_str());
+  socketPath.clear();
+  if (masked)
+    pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+  masked = false;
+}
+
+inline void QueryServer::Worker(unsigned int t) {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(jobMutex);
+      jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (stopping)
+        return;
+      job = jobs.front();
+      jobs.pop_front();
+    }
+
+    QueryResult result;
+    if (job.valid)
+      handler(job.src, job.dst, t, result);
+    Done answer;
+    answer.conn = job.conn;
+    answer.seq = job.seq;
+    Format(job, result, answer.bytes);
+
+    // Only the answer that finds the list empty needs to wake the loop,
+    // which takes the whole list at once
+    bool wake;
+    {
+      std::lock_guard<std::mutex> lock(doneMutex);
+      wake = done.empty();
+      done.push_back(std::move(answer));
+    }
+    if (wake) {
+      uint64_t one = 1;
+      ssize_t written = write(wakeFd, &one, sizeof(one));
+      (void)written;
+    }
+  }
+}
+
+inline void QueryServer::Format(const Job &job, const QueryResult &result,
+                                std::string &bytes) {
+  if (job.binary) {
+    QueryAnswer answer;
+    answer.status = !job.valid ? kQueryInvalid
+        : result.path.empty() ? kQueryNoPath : kQueryFound;
+    answer.numVertices = result.path.size();
+    answer.distance = result.distance;
+    bytes.append(reinterpret_cast<const char *>(&answer), sizeof(answer));
+    for (auto v = result.path.rbegin(); v != result.path.rend(); ++v) {
+      uint32_t vertex = *v;
+      bytes.append(reinterpret_cast<const char *>(&vertex), sizeof(vertex));
+    }
+    return;
+  }
+
+  if (!job.valid) {
+    bytes = "Error: invalid query\n";
+    return;
+  }
+  // Same as ShortestPath::Print()
+  std::ostringstream os;
+  os << job.src << " to " << job.dst << ": ";
+  if (result.path.empty()) {
+    os << "no path" << '\n';
+  } else {
+    for (auto i = result.path.size() - 1; i >= 1; i--)
+      os << result.path[i] << " => ";
+    os << result.path.front() << " (" << result.distance << ')' << '\n';
+  }
+  bytes = os.str();
+}
+
+inline void QueryServer::Accept(void) {
+  for (;;) {
+    int fd = accept4(listenFd, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+
+    uint64_t id = nextId++;
+    std::unique_ptr<Connection> c(new Connection());
+    c->fd = fd;
+    c->events = EPOLLIN;
+    epoll_event ev;
+    ev.events = c->events;
+    ev.data.u64 = id;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      close(fd);
+      continue;
+    }
+    connections[id] = std::move(c);
+    numAccepted++;
+  }
+}
+
+inline bool QueryServer::Receive(Connection &c) {
+  // Parsed requests are dropped before the buffer grows
+  if (c.inPos > kReadSize && c.inPos * 2 > c.in.size()) {
+    c.in.erase(0, c.inPos);
+    c.inPos = 0;
+  }
+
+  size_t size = c.in.size();
+  c.in.resize(size + kReadSize);
+  ssize_t n = read(c.fd, &c.in[size], kReadSize);
+  c.in.resize(size + std::max<ssize_t>(n, 0));
+  if (n == 0)
+    c.eof = true;
+  return n >= 0 || errno == EAGAIN || errno == EINTR;
+}
+
+inline void QueryServer::Parse(uint64_t id, Connection &c) {
+  if (!c.protocolKnown) {
+    size_t have = std::min(c.in.size() - c.inPos, sizeof(kQueryBinaryMagic));
+    bool prefix = std::memcmp(c.in.data() + c.inPos, kQueryBinaryMagic,
+                              have) == 0;
+    if (prefix && have < sizeof(kQueryBinaryMagic) && !c.eof)
+      return;  // Wait for the rest of the magic
+    c.binary = prefix && have == sizeof(kQueryBinaryMagic);
+    if (c.binary)
+      c.inPos += sizeof(kQueryBinaryMagic);
+    c.protocolKnown = true;
+  }
+
+  while (HasRoom(c) && c.inPos < c.in.size()) {
+    Job job;
+    job.conn = id;
+    job.binary = c.binary;
+
+    if (c.binary) {
+      if (c.in.size() - c.inPos < sizeof(QueryRequest)) {
+        if (c.eof)
+          c.inPos = c.in.size();  // Truncated last request
+        break;
+      }
+      QueryRequest request;
+      std::memcpy(&request, c.in.data() + c.inPos, sizeof(request));
+      c.inPos += sizeof(request);
+      job.src = request.src;
+      job.dst = request.dst;
+      job.valid = request.src < static_cast<uint32_t>(numVertices)
+          && request.dst < static_cast<uint32_t>(numVertices);
+    } else {
+      // The last line may lack its newline once the client is done
+      size_t end = c.in.find('\n', c.inPos);
+      if (end == std::string::npos && !c.eof)
+        break;
+      if (end == std::string::npos)
+        end = c.in.size();
+      const char *line = c.in.data() + c.inPos;
+      size_t length = end - c.inPos;
+      c.inPos = std::min(end + 1, c.in.size());
+      if (std::string(line, length).find_first_not_of(" \t\r")
+          == std::string::npos)
+        continue;
+      ParseLine(line, length, job);
+    }
+
+    job.seq = c.nextSeq++;
+    newJobs.push_back(job);
+    numServed++;
+  }
+}
+
+inline void QueryServer::ParseLine(const char *line, size_t length,
+                                   Job &job) const {
+  std::istringstream ss(std::string(line, length));
+  long long src, dst;
+
+  job.valid = static_cast<bool>(ss >> src >> dst) && src >= 0
+      && dst >= 0 && src < numVertices && dst < numVertices;
+  job.src = job.valid ? src : 0;
+  job.dst = job.valid ? dst : 0;
+}
+
+inline void QueryServer::Collect(void) {
+  uint64_t count;
+  ssize_t n = read(wakeFd, &count, sizeof(count));
+  (void)n;
+
+  std::vector<Done> answers;
+  {
+    std::lock_guard<std::mutex> lock(doneMutex);
+    answers.swap(done);
+  }
+
+  std::vector<uint64_t> touched;
+  for (Done &answer : answers) {
+    auto it = connections.find(answer.conn);
+    if (it == connections.end())
+      continue;  // Closed while the query ran
+    Connection &c = *it->second;
+    if (answer.seq != c.nextOut) {
+      c.ready[answer.seq] = std::move(answer.bytes);
+      continue;
+    }
+    c.out += answer.bytes;
+    c.nextOut++;
+    for (auto next = c.ready.find(c.nextOut); next != c.ready.end();
+         next = c.ready.find(c.nextOut)) {
+      c.out += next->second;
+      c.ready.erase(next);
+      c.nextOut++;
+    }
+    touched.push_back(answer.conn);
+  }
+
+  for (uint64_t id : touched) {
+    auto it = connections.find(id);
+    if (it == connections.end())
+      continue;  // Already closed by an earlier entry of touched
+    Connection &c = *it->second;
+    bool failed = !Send(c);
+    // Room for the requests held back by the in-flight and unsent limits
+    if (!failed)
+      Parse(id, c);
+    Update(id, failed);
+  }
+}
+
+inline bool QueryServer::Send(Connection &c) {
+  while (c.outPos < c.out.size()) {
+    ssize_t n = send(c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos,
+                     MSG_NOSIGNAL);
+    if (n < 0) {
+      // Sent answers are dropped before the buffer grows
+      if (c.outPos > kReadSize && c.outPos * 2 > c.out.size()) {
+        c.out.erase(0, c.outPos);
+        c.outPos = 0;
+      }
+      return errno == EAGAIN || errno == EINTR;
+    }
+    c.outPos += n;
+  }
+  c.out.clear();
+  c.outPos = 0;
+  return true;
+}
+
+// Answers count as in flight until they are sent, not only until they are
+// ready: a client that does not read would otherwise grow @out without
+// bound. Up to kMaxInFlight answers may still come on top of kMaxUnsent.
+inline bool QueryServer::HasRoom(const Connection &c) {
+  return c.nextSeq - c.nextOut < kMaxInFlight
+      && c.out.size() - c.outPos < kMaxUnsent;
+}
+
+inline void QueryServer::Update(uint64_t id, bool failed) {
+  Connection &c = *connections[id];
+  bool idle = c.nextOut == c.nextSeq && c.outPos == c.out.size();
+
+  if (failed || (c.eof && idle && c.inPos == c.in.size())) {
+    Close(id);
+    return;
+  }
+
+  uint32_t events = 0;
+  if (!c.eof && HasRoom(c))
+    events |= EPOLLIN;
+  if (c.outPos < c.out.size())
+    events |= EPOLLOUT;
+  if (events != c.events) {
+    epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = id;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+    c.events = events;
+  }
+}
+
+inline void QueryServer::Close(uint64_t id) {
+  auto it = connections.find(id);
+  if (it == connections.end())
+    return;
+  close(it->second->fd);
+  connections.erase(it);
+}
+
+#endif  // QUERY_SERVER_H_
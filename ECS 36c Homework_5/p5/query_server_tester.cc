@@ -0,0 +1,121 @@
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "query_server.h"
+
+// Queries sent by the client: far more answer bytes than the server may
+// hold for a client that does not read
+const int kNumVertices = 100;
+const int kNumQueries = 300000;
+
+std::string Query(int i) {
+  std::ostringstream os;
+  os << i % kNumVertices << ' ' << i * 7 % kNumVertices << '\n';
+  return os.str();
+}
+
+// Same as the server formats the path {dst, src} of the handler below
+std::string Answer(int i) {
+  int src = i % kNumVertices, dst = i * 7 % kNumVertices;
+  std::ostringstream os;
+  os << src << " to " << dst << ": " << src << " => " << dst << " ("
+     << src + dst << ")\n";
+  return os.str();
+}
+
+// Tester
+int main() {
+  // The server reads SIGTERM from a signalfd, so no thread may take it
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+  QueryServer server(kNumVertices, 2,
+                     [](unsigned int src, unsigned int dst, unsigned int,
+                        QueryResult &result) {
+                       result.distance = src + dst;
+                       result.path = {static_cast<int>(dst),
+                                      static_cast<int>(src)};
+                     });
+  std::string socketPath = "/tmp/query_server_tester."
+      + std::to_string(getpid()) + ".sock";
+  if (server.Listen(socketPath) == -1)
+    return 1;
+  std::thread run([&server] { server.Run(); });
+
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size());
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    std::cout << "Cannot connect: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+
+  // A client that sends without reading: the server should stop reading
+  // it once its answers pile up, so that sending stalls
+  std::string requests;
+  for (int i = 0; i < kNumQueries; i++)
+    requests += Query(i);
+  size_t sent = 0;
+  bool stalled = false;
+  while (sent < requests.size() && !stalled) {
+    ssize_t n = send(fd, requests.data() + sent, requests.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else {
+      pollfd p = {fd, POLLOUT, 0};
+      stalled = poll(&p, 1, 1000) == 0;
+    }
+  }
+  // Sending should stall long before all requests are out (1)
+  std::cout << "Stalled before all requests= " << stalled << std::endl;
+
+  // Reading the answers lets the rest of the requests through, and the
+  // answers come back in request order
+  std::string expected;
+  for (int i = 0; i < kNumQueries; i++)
+    expected += Answer(i);
+  std::string received;
+  char buffer[64 << 10];
+  while (received.size() < expected.size()) {
+    short events = POLLIN | (sent < requests.size() ? POLLOUT : 0);
+    pollfd p = {fd, events, 0};
+    if (poll(&p, 1, 10000) <= 0)
+      break;
+    if (p.revents & POLLOUT) {
+      ssize_t n = send(fd, requests.data() + sent, requests.size() - sent,
+                       MSG_NOSIGNAL);
+      if (n > 0)
+        sent += n;
+    }
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n == 0)
+      break;
+    if (n > 0)
+      received.append(buffer, n);
+  }
+  // Every answer should match (1)
+  std::cout << "All answers in order= " << (received == expected)
+            << std::endl;
+
+  close(fd);
+  kill(getpid(), SIGTERM);
+  run.join();
+
+  return stalled && received == expected ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+
+#include "bucket_queue.h"
+#include "index_min_pq.h"
+#include "radix_heap.h"
+
+const int kCapacity = 200;
+const int kNumOperations = 200000;
+// Keys are pushed at most this far above the last minimum
+const double kKeySpread = 125;
+
+// Runs random pushes, key changes and pops on @queue, checking Size(),
+// Contains() and the key of each Top() against a plain map
+// Monotone queues only get keys no smaller than the last Top(), and a
+// bucket queue of @width may return any key of the lowest bucket
+// (@width 0 for an exact minimum)
+// Returns the number of mismatches
+template <typename Queue>
+int CheckRandom(Queue &queue, unsigned int seed, bool monotone,
+                double width) {
+  std::mt19937 rng(seed);
+  std::map<unsigned int, double> keys;
+  double last = 0;
+  int mismatches = 0;
+
+  for (int i = 0; i < kNumOperations; i++) {
+    unsigned int idx = rng() % kCapacity;
+    double key = (monotone ? last : 0) + rng() % 1000 / 8.0;
+    int op = rng() % 10;
+
+    if (op < 4 && !keys.count(idx)) {
+      queue.Push(key, idx);
+      keys[idx] = key;
+    } else if (op < 7 && keys.count(idx)) {
+      queue.ChangeKey(key, idx);
+      keys[idx] = key;
+    } else if (op < 10 && !keys.empty()) {
+      double min = keys.begin()->second;
+      for (auto &entry : keys)
+        min = std::min(min, entry.second);
+      unsigned int top = queue.Top();
+      if (!keys.count(top))
+        mismatches++;
+      else if (width ? std::floor(keys[top] / width) != std::floor(min / width)
+                     : keys[top] != min)
+        mismatches++;
+      else
+        last = keys[top];
+      queue.Pop();
+      keys.erase(top);
+    }
+
+    if (queue.Size() != keys.size() || queue.Contains(idx) != keys.count(idx))
+      mismatches++;
+  }
+  return mismatches;
+}
+
+// The item Pop() moves to the root stays there when it is the smallest,
+// and a later ChangeKey() on it must still find it
+template <typename Queue>
+int CheckPopThenChangeKey(Queue &queue) {
+  int mismatches = 0;
+  queue.Push(1.0, 10);
+  queue.Push(2.0, 11);
+  queue.Pop();
+  queue.Push(3.0, 12);
+  queue.Push(4.0, 13);
+  queue.ChangeKey(5.0, 11);
+  unsigned int expected[3] = {12, 13, 11};
+  for (unsigned int idx : expected) {
+    if (queue.Top() != idx)
+      mismatches++;
+    queue.Pop();
+  }
+  return mismatches;
+}
+
+// @make returns an empty queue of kCapacity indexes
+template <typename Make>
+int Check(const std::string &name, Make make, bool monotone = false,
+          double width = 0) {
+  int mismatches = 0;
+  for (unsigned int seed = 1; seed <= 3; seed++) {
+    auto queue = make();
+    mismatches += CheckRandom(queue, seed, monotone, width);
+  }
+  auto queue = make();
+  mismatches += CheckPopThenChangeKey(queue);
+
+  // Mismatches should be 0
+  std::cout << name << " mismatches= " << mismatches << std::endl;
+  return mismatches;
+}
+
+// Tester
+int main() {
+  int mismatches = 0;
+  mismatches += Check("IndexMinPQ<double, 2>",
+                      [] { return IndexMinPQ<double, 2>(kCapacity); });
+  mismatches += Check("IndexMinPQ<double, 3>",
+                      [] { return IndexMinPQ<double, 3>(kCapacity); });
+  mismatches += Check("IndexMinPQ<double, 4>",
+                      [] { return IndexMinPQ<double, 4>(kCapacity); });
+  mismatches += Check("IndexMinPQ<double, 8>",
+                      [] { return IndexMinPQ<double, 8>(kCapacity); });
+  mismatches += Check("RadixHeap<double>",
+                      [] { return RadixHeap<double>(kCapacity); }, true);
+  // Width 1 keeps the keys of CheckPopThenChangeKey in separate buckets
+  mismatches += Check("BucketQueue<double>", [] {
+    return BucketQueue<double>(kCapacity, 1, kKeySpread);
+  }, true, 1);
+
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+#ifndef RADIX_HEAP_H_
+#define RADIX_HEAP_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Maps a key to an unsigned integer with the same order. Non-negative
+// doubles order like their bit patterns (adding 0.0 turns -0.0 into 0.0).
+inline uint64_t RadixKey(double key) {
+  uint64_t bits;
+  key += 0.0;
+  std::memcpy(&bits, &key, sizeof(bits));
+  return bits;
+}
+
+inline uint64_t RadixKey(uint64_t key) {
+  return key;
+}
+
+inline uint64_t RadixKey(unsigned int key) {
+  return key;
+}
+
+// Indexed monotone priority queue with the interface of IndexMinPQ. Keys
+// pushed or changed must not be smaller than the last key returned by
+// Top(), which Dijkstra guarantees. Item i sits in bucket b when its key
+// first differs from that last key at bit b - 1 (bucket 0 if equal), so
+// items only ever move to lower buckets and each one moves at most 64
+// times. Works on integer keys and on non-negative doubles without scaling.
+template <typename K>
+class RadixHeap {
+ public:
+  // Constructor with max number of indexes
+  explicit RadixHeap(int capacity);
+  // Return number of items
+  unsigned int Size();
+  // Return top (ie index associated to minimum key)
+  unsigned int Top();
+  // Remove top
+  void Pop();
+  // Associates @key with index @idx
+  void Push(const K &key, unsigned int idx);
+  // Return whether @idx is a valid index
+  bool Contains(unsigned int idx);
+  // Change key associated to index @idx
+  void ChangeKey(const K &key, unsigned int idx);
+  // Remove all items, in time proportional to the current size
+  void Clear();
+
+ private:
+  static const int kNumBuckets = 65;
+
+  unsigned int capacity;
+  unsigned int cur_size;
+  // Last minimum, the reference all bucket numbers are relative to
+  uint64_t last;
+  std::vector<uint64_t> keys;
+  // Bucket of each index, -1 if not in the queue, and position in it
+  std::vector<int> idx_to_bucket;
+  std::vector<unsigned int> idx_to_pos;
+  std::vector<unsigned int> buckets[kNumBuckets];
+  // Items being redistributed by Refill()
+  std::vector<unsigned int> moving;
+
+  int BucketOf(uint64_t key) {
+    return key == last ? 0 : 64 - __builtin_clzll(key ^ last);
+  }
+  void Insert(unsigned int idx);
+  void Remove(unsigned int idx);
+  // Moves the smallest keys to bucket 0 if it is empty
+  void Refill();
+};
+
+template <typename K>
+RadixHeap<K>::RadixHeap(int capacity)
+    : capacity(capacity),
+      cur_size(0),
+      last(0),
+      keys(capacity),
+      idx_to_bucket(capacity, -1),
+      idx_to_pos(capacity) {}
+
+template <typename K>
+unsigned int RadixHeap<K>::Size() {
+  return cur_size;
+}
+
+template <typename K>
+void RadixHeap<K>::Insert(unsigned int idx) {
+  int b = BucketOf(keys[idx]);
+  idx_to_bucket[idx] = b;
+  idx_to_pos[idx] = buckets[b].size();
+  buckets[b].push_back(idx);
+}
+
+template <typename K>
+void RadixHeap<K>::Remove(unsigned int idx) {
+  std::vector<unsigned int> &bucket = buckets[idx_to_bucket[idx]];
+  unsigned int moved = bucket.back();
+
+  bucket[idx_to_pos[idx]] = moved;
+  idx_to_pos[moved] = idx_to_pos[idx];
+  bucket.pop_back();
+  idx_to_bucket[idx] = -1;
+}
+
+template <typename K>
+void RadixHeap<K>::Refill() {
+  if (!buckets[0].empty())
+    return;
+
+  int b = 1;
+  while (buckets[b].empty())
+    b++;
+
+  // The new minimum becomes the reference; every other key of bucket b
+  // then shares more leading bits with it and lands in a lower bucket
+  uint64_t min = keys[buckets[b][0]];
+  for (unsigned int idx : buckets[b])
+    min = std::min(min, keys[idx]);
+  last = min;
+
+  moving.swap(buckets[b]);
+  for (unsigned int idx : moving)
+    Insert(idx);
+  moving.clear();
+}
+
+template <typename K>
+unsigned int RadixHeap<K>::Top() {
+  if (!Size())
+    throw std::underflow_error("Priority queue underflow!");
+
+  Refill();
+  return buckets[0].back();
+}
+
+template <typename K>
+void RadixHeap<K>::Pop() {
+  if (!Size())
+    throw std::underflow_error("Empty priority queue!");
+
+  Refill();
+  idx_to_bucket[buckets[0].back()] = -1;
+  buckets[0].pop_back();
+  cur_size--;
+}
+
+template <typename K>
+void RadixHeap<K>::Push(const K &key, unsigned int idx) {
+  if (idx >= capacity)
+    throw std::overflow_error("Index invalid!");
+  if (Contains(idx))
+    throw std::runtime_error("Index already exists!");
+  if (RadixKey(key) < last)
+    throw std::runtime_error("Key below the last minimum!");
+
+  keys[idx] = RadixKey(key);
+  Insert(idx);
+  cur_size++;
+}
+
+template <typename K>
+bool RadixHeap<K>::Contains(unsigned int idx) {
+  if (idx >= capacity)
+    throw std::overflow_error("Index invalid!");
+  return idx_to_bucket[idx] != -1;
+}
+
+template <typename K>
+void RadixHeap<K>::ChangeKey(const K &key, unsigned int idx) {
+  if (idx >= capacity)
+    throw std::overflow_error("Index invalid!");
+  if (!Contains(idx))
+    throw std::runtime_error("Index does not exist!");
+  if (RadixKey(key) < last)
+    throw std::runtime_error("Key below the last minimum!");
+
+  Remove(idx);
+  keys[idx] = RadixKey(key);
+  Insert(idx);
+}
+
+template <typename K>
+void RadixHeap<K>::Clear() {
+  for (std::vector<unsigned int> &bucket : buckets) {
+    for (unsigned int idx : bucket)
+      idx_to_bucket[idx] = -1;
+    bucket.clear();
+  }
+  cur_size = 0;
+  last = 0;
+}
+
+#endif  // RADIX_HEAP_H_
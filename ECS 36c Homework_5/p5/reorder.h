@@ -0,0 +1,123 @@
+#ifndef REORDER_H_
+#define REORDER_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "graph.h"
+
+// Vertex orderings that give neighbouring vertices nearby ids, so that a
+// search touching the neighbours of a vertex touches nearby entries of
+// every per-vertex array
+enum VertexOrder { kBfsOrder, kRcmOrder };
+
+// Breadth-first numbering of the component of @start, over out- and
+// in-edges, appended to @sequence. With @byDegree, the neighbours of each
+// vertex are numbered by increasing degree (Cuthill-McKee).
+inline void NumberComponent(const Graph &g, unsigned int start, bool byDegree,
+                            const std::vector<unsigned int> &degree,
+                            std::vector<bool> &seen,
+                            std::vector<unsigned int> &sequence) {
+  std::vector<unsigned int> neighbours;
+  size_t head = sequence.size();
+
+  seen[start] = true;
+  sequence.push_back(start);
+  while (head < sequence.size()) {
+    unsigned int u = sequence[head++];
+
+    neighbours.clear();
+    for (const Edge &e : g.GetEdges(u))
+      neighbours.push_back(e.GetEdgeDest());
+    for (const Edge &e : g.GetReverseEdges(u))
+      neighbours.push_back(e.GetEdgeDest());
+    if (byDegree) {
+      std::stable_sort(neighbours.begin(), neighbours.end(),
+                       [&degree](unsigned int a, unsigned int b) {
+                         return degree[a] < degree[b];
+                       });
+    }
+
+    for (unsigned int v : neighbours) {
+      if (!seen[v]) {
+        seen[v] = true;
+        sequence.push_back(v);
+      }
+    }
+  }
+}
+
+// Last vertex reached by a breadth-first search from @start, a cheap
+// pseudo-peripheral starting point for Cuthill-McKee. @seen must be all
+// false, and is left that way.
+inline unsigned int FarVertex(const Graph &g, unsigned int start,
+                              const std::vector<unsigned int> &degree,
+                              std::vector<bool> &seen) {
+  std::vector<unsigned int> sequence;
+
+  NumberComponent(g, start, true, degree, seen, sequence);
+  for (unsigned int v : sequence)
+    seen[v] = false;
+  return sequence.back();
+}
+
+// Returns newId, where newId[u] is the new id of u, for Graph::Renumber().
+// Builds the reverse adjacency of @g if it is missing.
+inline std::vector<unsigned int> ComputeOrder(Graph &g, VertexOrder order) {
+  int numVertices = g.GetNumVertices();
+  std::vector<unsigned int> degree(numVertices);
+  std::vector<unsigned int> sequence;
+  std::vector<bool> seen(numVertices, false);
+
+  if (!g.HasReverse())
+    g.BuildReverse();
+  for (int u = 0; u < numVertices; u++)
+    degree[u] = g.GetEdges(u).size() + g.GetReverseEdges(u).size();
+
+  if (order == kBfsOrder) {
+    for (int u = 0; u < numVertices; u++) {
+      if (!seen[u])
+        NumberComponent(g, u, false, degree, seen, sequence);
+    }
+  } else {
+    // Components start from a far end, found from their lowest degree
+    // vertex; the whole order is then reversed
+    std::vector<unsigned int> byDegree(numVertices);
+    std::vector<bool> scratch(numVertices, false);
+    for (int u = 0; u < numVertices; u++)
+      byDegree[u] = u;
+    std::stable_sort(byDegree.begin(), byDegree.end(),
+                     [&degree](unsigned int a, unsigned int b) {
+                       return degree[a] < degree[b];
+                     });
+    for (unsigned int u : byDegree) {
+      if (!seen[u])
+        NumberComponent(g, FarVertex(g, u, degree, scratch), true, degree,
+                        seen, sequence);
+    }
+    std::reverse(sequence.begin(), sequence.end());
+  }
+
+  std::vector<unsigned int> newId(numVertices);
+  for (int i = 0; i < numVertices; i++)
+    newId[sequence[i]] = i;
+  return newId;
+}
+
+// Largest and mean |u - v| over the edges u -> v of @g
+inline void EdgeSpan(const Graph &g, unsigned int &bandwidth, double &mean) {
+  double total = 0;
+
+  bandwidth = 0;
+  for (int u = 0; u < g.GetNumVertices(); u++) {
+    for (const Edge &e : g.GetEdges(u)) {
+      unsigned int span = std::abs(static_cast<int>(e.GetEdgeDest()) - u);
+      bandwidth = std::max(bandwidth, span);
+      total += span;
+    }
+  }
+  mean = g.GetNumEdges() ? total / g.GetNumEdges() : 0;
+}
+
+#endif  // REORDER_H_
@@ -0,0 +1,143 @@
+#ifndef SEARCH_STATS_H_
+#define SEARCH_STATS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Search instrumentation, built in with -DSEARCH_STATS (make STATS=1).
+// Otherwise every counting hook is empty, the counters are not even
+// members of the queues and workspaces, and all stats read zero.
+#ifdef SEARCH_STATS
+const bool kSearchStats = true;
+#else
+const bool kSearchStats = false;
+#endif
+
+// Operations on a priority queue since it was last cleared
+struct QueueStats {
+  uint64_t numPushes = 0;
+  uint64_t numChangeKeys = 0;
+  uint64_t numPops = 0;
+  unsigned int maxDepth = 0;  // Levels of the heap at its largest
+};
+
+// Work and wall time of one query, or of many added up
+struct SearchStats {
+  uint64_t numSettled = 0;
+  uint64_t numRelaxed = 0;  // Out-edges of the settled vertices
+  uint64_t numImproved = 0;  // Relaxations that lowered a distance
+  QueueStats queue;
+  double searchSeconds = 0;
+  double unwindSeconds = 0;  // Reading the path back from the labels
+
+  // Sums up counts and times, and keeps the deepest heap
+  void Add(const SearchStats &other);
+  // Writes the stats as members of a JSON object, without the braces
+  void WriteJsonMembers(std::ostream &os) const;
+};
+
+// Stats of a queue that does not count its operations
+template <typename Queue>
+QueueStats GetQueueStats(const Queue &) {
+  return QueueStats();
+}
+
+// Wall clock for the phases of a query, reading 0 unless built with
+// SEARCH_STATS
+class PhaseTimer {
+ public:
+  PhaseTimer();
+  // Seconds since construction or the previous Lap()
+  double Lap(void);
+
+ private:
+#ifdef SEARCH_STATS
+  std::chrono::steady_clock::time_point last;
+#endif
+};
+
+// Writes the stats of answered queries to @os as JSON: one line per query
+// as they are added, or with @perQuery false one object for all of them
+// when finished
+class StatsReport {
+ public:
+  StatsReport(std::ostream &os, bool perQuery, double loadSeconds);
+  void Add(int src, int dst, const SearchStats &stats);
+  void Finish(void);
+
+ private:
+  std::ostream &os;
+  bool perQuery;
+  double loadSeconds;
+  uint64_t numQueries = 0;
+  SearchStats total;
+};
+
+inline void SearchStats::Add(const SearchStats &other) {
+  numSettled += other.numSettled;
+  numRelaxed += other.numRelaxed;
+  numImproved += other.numImproved;
+  queue.numPushes += other.queue.numPushes;
+  queue.numChangeKeys += other.queue.numChangeKeys;
+  queue.numPops += other.queue.numPops;
+  queue.maxDepth = std::max(queue.maxDepth, other.queue.maxDepth);
+  searchSeconds += other.searchSeconds;
+  unwindSeconds += other.unwindSeconds;
+}
+
+inline void SearchStats::WriteJsonMembers(std::ostream &os) const {
+  os << "\"settled\": " << numSettled << ", \"relaxed\": " << numRelaxed
+     << ", \"improved\": " << numImproved << ", \"pushes\": "
+     << queue.numPushes << ", \"change_keys\": " << queue.numChangeKeys
+     << ", \"pops\": " << queue.numPops << ", \"heap_depth\": "
+     << queue.maxDepth << ", \"search_us\": " << searchSeconds * 1e6
+     << ", \"unwind_us\": " << unwindSeconds * 1e6;
+}
+
+#ifdef SEARCH_STATS
+inline PhaseTimer::PhaseTimer() : last(std::chrono::steady_clock::now()) {}
+
+inline double PhaseTimer::Lap(void) {
+  std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = now - last;
+  last = now;
+  return elapsed.count();
+}
+#else
+inline PhaseTimer::PhaseTimer() {}
+
+inline double PhaseTimer::Lap(void) {
+  return 0;
+}
+#endif
+
+inline StatsReport::StatsReport(std::ostream &os, bool perQuery,
+                                double loadSeconds)
+    : os(os), perQuery(perQuery), loadSeconds(loadSeconds) {}
+
+inline void StatsReport::Add(int src, int dst, const SearchStats &stats) {
+  numQueries++;
+  total.Add(stats);
+  if (!perQuery)
+    return;
+
+  os << "{\"src\": " << src << ", \"dst\": " << dst << ", ";
+  stats.WriteJsonMembers(os);
+  os << "}\n";
+}
+
+inline void StatsReport::Finish(void) {
+  if (perQuery) {
+    os.flush();
+    return;
+  }
+  os << "{\"queries\": " << numQueries << ", \"load_us\": "
+     << loadSeconds * 1e6 << ", ";
+  total.WriteJsonMembers(os);
+  os << "}" << std::endl;
+}
+
+#endif  // SEARCH_STATS_H_
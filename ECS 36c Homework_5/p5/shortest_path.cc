@@ -1,91 +1,760 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
 #include <vector>
-#include <fstream>
 #include <string>
 #include <limits>
 #include <cmath>
 
+#include "arc_flags.h"
+#include "bucket_queue.h"
+#include "compressed_graph.h"
+#include "contraction_hierarchy.h"
+#include "delta_stepping.h"
+#include "dijkstra.h"
+#include "distance_file.h"
+#include "dynamic_tree.h"
+#include "ewd_text.h"
+#include "graph.h"
+#include "hub_labels.h"
 #include "index_min_pq.h"
+#include "landmarks.h"
+#include "query_server.h"
+#include "radix_heap.h"
+#include "reorder.h"
+#include "search_stats.h"
+#include "shortest_path.h"
+#include "tree_cache.h"
 
-class Edge {
- public:
-  Edge(unsigned int dest, double weight);
-  unsigned int GetEdgeDest(void);
-  double GetWeight(void);
-
-  friend std::ostream& operator <<(std::ostream &os, Edge &e);
- private:
-  unsigned int edgeDestVertex;
-  double weight;
+enum SearchMode {
+  kDijkstra, kBidirectional, kLandmarks, kHierarchy, kDeltaStepping,
+  kHubLabels, kArcFlags
 };
 
-class Vertex {
- public:
-  void AddEdge(unsigned int edgeDestVertex, double edgeWeight);
-  std::vector<Edge> vertex;
-  friend std::ostream& operator <<(std::ostream &os, Vertex &v);
+// Priority queue behind plain Dijkstra searches
+enum QueueKind { kBinaryHeap, kRadixHeap, kBucketQueue };
+
+typedef BasicDijkstraWorkspace<RadixHeap<double>> RadixWorkspace;
+typedef BasicDijkstraWorkspace<BucketQueue<double>> BucketWorkspace;
+
+// Checks that @src and @dst are vertices of @g
+// Prints an error and returns false otherwise
+template <typename G>
+bool CheckQuery(const G &g, int src, int dst) {
+  if (g.GetNumVertices() <= src || src < 0) {
+    std::cerr << "Error: invalid source vertex number ";
+    std::cerr << src << std::endl;
+    return false;
+  }
+  if (g.GetNumVertices() <= dst || dst < 0) {
+    std::cerr << "Error: invalid dest vertex number ";
+    std::cerr << dst << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Reads the "src dst" query on line @lineNumber of a query file
+// Returns 1 for a blank line, -1 after printing an error if @line is not a
+// query of vertices of @g, 0 otherwise
+template <typename G>
+int ParseQuery(const G &g, const std::string &line, int lineNumber,
+               int &src, int &dst) {
+  if (line.find_first_not_of(" \t\r") == std::string::npos)
+    return 1;
+
+  std::istringstream ss(line);
+  if (!(ss >> src >> dst)) {
+    std::cerr << "Error: invalid query on line " << lineNumber << std::endl;
+    return -1;
+  }
+  return CheckQuery(g, src, dst) ? 0 : -1;
+}
+
+// Preprocessed data and settings some search modes need, shared read-only
+// by all threads
+struct SearchIndex {
+  const Landmarks *landmarks = nullptr;
+  const ContractionHierarchy *hierarchy = nullptr;
+  const HubLabels *hubLabels = nullptr;
+  const ArcFlags *arcFlags = nullptr;
+  // Trees of plain Dijkstra by source, if any; locked internally
+  TreeCache *treeCache = nullptr;
+  double delta = 0;  // Bucket width for delta-stepping
+  QueueKind queue = kBinaryHeap;
+  // Edge weight range, bucket width and spread of the bucket queue
+  double minWeight = 0, maxWeight = 0;
 };
 
-class Graph {
+// Copies the distances to @targets held by @labels into @row
+template <typename Labels>
+void CopyRow(const Labels &labels, const std::vector<unsigned int> &targets,
+             double *row) {
+  for (size_t j = 0; j < targets.size(); j++)
+    row[j] = labels.GetDist(targets[j]);
+}
+
+// Answers independent queries over a pool of threads that share one
+// read-only graph. Every worker owns its Dijkstra workspaces, and workers
+// only write to the ShortestPath objects they were handed. Delta-stepping
+// instead answers the queries one at a time with all threads on each.
+class ParallelQueryEngine {
  public:
-  int ExtractFile(const std::string &fileName);
-  int GetNumVertices(void);
-  std::vector<Vertex>& GetAdjList(void);
-  void Print(void);
+  ParallelQueryEngine(const Graph &g, int numThreads, SearchMode mode,
+                      const SearchIndex &index);
+  // Answers every element of @paths, which keep their order
+  void Run(std::vector<ShortestPath> &paths);
+  // Full search from every element of @sources. Row i of @rows gets the
+  // distances from sources[i] to @targets. Only for kDijkstra,
+  // kDeltaStepping and kHubLabels, which merges labels instead.
+  void RunRows(const std::vector<unsigned int> &sources,
+               const std::vector<unsigned int> &targets,
+               std::vector<double> &rows);
+  // Answers @path with the workspaces of thread @t, for callers that run
+  // their own threads. Not for kDeltaStepping, whose threads are shared.
+  void Answer(ShortestPath &path, unsigned int t);
+  // Vertices settled by every search so far, over all threads
+  uint64_t GetNumSettled(void) const;
+
  private:
-  int numVertices = 0;
-  int numEdges = 0;
+  // Calls task(i, t) for every i below @n, where t is the index of the
+  // calling thread. Threads claim @chunk items at a time.
+  template <typename Task>
+  void ForEach(size_t n, unsigned int chunk, Task task);
+  // Plain Dijkstra through the tree cache of the index, if there is one
+  template <typename Queue>
+  void PlainDijkstra(ShortestPath &path, BasicDijkstraWorkspace<Queue> &ws);
+
+  // Queries a worker claims at once, to keep the shared counter cold
+  static const unsigned int kChunkSize = 16;
 
-  std::vector<Vertex> AdjList;
+  const Graph &g;
+  int numThreads;
+  SearchMode mode;
+  SearchIndex index;
+  std::vector<DijkstraWorkspace> workspaces;
+  // Backward search workspaces, only allocated for bidirectional searches
+  std::vector<DijkstraWorkspace> backWorkspaces;
+  // Plain Dijkstra workspaces with another priority queue, in place of
+  // workspaces
+  std::vector<RadixWorkspace> radixWorkspaces;
+  std::vector<BucketWorkspace> bucketWorkspaces;
+  std::unique_ptr<DeltaStepping> deltaStepping;
+  std::atomic<size_t> next;
 };
 
-class ShortestPath {
- public:
-  ShortestPath(int sourceVertex, int destVertex);
-  void Dijkstra(Graph &g);
-  void Print(void);
+ParallelQueryEngine::ParallelQueryEngine(const Graph &g, int numThreads,
+                                         SearchMode mode,
+                                         const SearchIndex &index)
+    : g(g), numThreads(numThreads), mode(mode), index(index), next(0) {
+  if (mode == kDeltaStepping) {
+    deltaStepping.reset(new DeltaStepping(g, index.delta, numThreads));
+    return;
+  }
+  if (mode == kDijkstra && index.queue == kRadixHeap) {
+    radixWorkspaces.assign(numThreads, RadixWorkspace(g.GetNumVertices()));
+    return;
+  }
+  if (mode == kDijkstra && index.queue == kBucketQueue) {
+    BucketQueue<double> queue(g.GetNumVertices(), index.minWeight,
+                              index.maxWeight);
+    bucketWorkspaces.assign(numThreads,
+                            BucketWorkspace(g.GetNumVertices(), queue));
+    return;
+  }
+  workspaces.assign(numThreads, DijkstraWorkspace(g.GetNumVertices()));
+  if (mode == kBidirectional || mode == kHierarchy)
+    backWorkspaces.assign(numThreads, DijkstraWorkspace(g.GetNumVertices()));
+}
 
- private:
-  int sourceVertex, destVertex;
+template <typename Task>
+void ParallelQueryEngine::ForEach(size_t n, unsigned int chunk, Task task) {
+  // Delta-stepping already keeps every thread busy on each item
+  if (numThreads == 1 || mode == kDeltaStepping) {
+    for (size_t i = 0; i < n; i++)
+      task(i, 0);
+    return;
+  }
+
+  next = 0;
+  auto worker = [this, n, chunk, &task](unsigned int t) {
+    for (;;) {
+      size_t first = next.fetch_add(chunk);
+      if (first >= n)
+        return;
+      size_t last = std::min<size_t>(first + chunk, n);
+      for (size_t i = first; i < last; i++)
+        task(i, t);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 1; t < numThreads; t++)
+    threads.push_back(std::thread(worker, t));
+  worker(0);
+  for (std::thread &t : threads)
+    t.join();
+}
+
+void ParallelQueryEngine::Answer(ShortestPath &path, unsigned int t) {
+  switch (mode) {
+    case kBidirectional:
+      path.BidirectionalDijkstra(g, workspaces[t], backWorkspaces[t]);
+      break;
+    case kLandmarks:
+      path.AStar(g, *index.landmarks, workspaces[t]);
+      break;
+    case kHierarchy:
+      path.HierarchyQuery(*index.hierarchy, workspaces[t], backWorkspaces[t]);
+      break;
+    case kDeltaStepping:
+      path.DeltaSteppingSearch(*deltaStepping);
+      break;
+    case kHubLabels:
+      path.HubLabelQuery(g, *index.hubLabels, workspaces[t]);
+      break;
+    case kArcFlags:
+      path.ArcFlagDijkstra(g, *index.arcFlags, workspaces[t]);
+      break;
+    default:
+      if (index.queue == kRadixHeap)
+        PlainDijkstra(path, radixWorkspaces[t]);
+      else if (index.queue == kBucketQueue)
+        PlainDijkstra(path, bucketWorkspaces[t]);
+      else
+        PlainDijkstra(path, workspaces[t]);
+  }
+}
+
+template <typename Queue>
+void ParallelQueryEngine::PlainDijkstra(ShortestPath &path,
+                                        BasicDijkstraWorkspace<Queue> &ws) {
+  if (index.treeCache)
+    path.CachedDijkstra(g, *index.treeCache, ws);
+  else
+    path.Dijkstra(g, ws);
+}
+
+uint64_t ParallelQueryEngine::GetNumSettled(void) const {
+  uint64_t numSettled = deltaStepping ? deltaStepping->GetNumSettled() : 0;
 
-  std::vector<int> shortestPath;
-  double shortestDistance;
+  for (const DijkstraWorkspace &ws : workspaces)
+    numSettled += ws.GetNumSettled();
+  for (const DijkstraWorkspace &ws : backWorkspaces)
+    numSettled += ws.GetNumSettled();
+  for (const RadixWorkspace &ws : radixWorkspaces)
+    numSettled += ws.GetNumSettled();
+  for (const BucketWorkspace &ws : bucketWorkspaces)
+    numSettled += ws.GetNumSettled();
+  return numSettled;
+}
+
+void ParallelQueryEngine::Run(std::vector<ShortestPath> &paths) {
+  ForEach(paths.size(), kChunkSize, [this, &paths](size_t i, unsigned int t) {
+    Answer(paths[i], t);
+  });
+}
+
+void ParallelQueryEngine::RunRows(const std::vector<unsigned int> &sources,
+                                  const std::vector<unsigned int> &targets,
+                                  std::vector<double> &rows) {
+  size_t numCols = targets.size();
+  rows.resize(sources.size() * numCols);
+
+  // Full searches are long enough to hand out one at a time
+  ForEach(sources.size(), 1, [&](size_t i, unsigned int t) {
+    double *row = rows.data() + i * numCols;
+    if (mode == kHubLabels) {
+      for (size_t j = 0; j < numCols; j++)
+        row[j] = index.hubLabels->Distance(sources[i], targets[j]);
+    } else if (mode == kDeltaStepping) {
+      deltaStepping->Run(sources[i]);
+      CopyRow(*deltaStepping, targets, row);
+    } else if (index.queue == kRadixHeap) {
+      RunDijkstra(g, sources[i], -1, false, radixWorkspaces[t]);
+      CopyRow(radixWorkspaces[t], targets, row);
+    } else if (index.queue == kBucketQueue) {
+      RunDijkstra(g, sources[i], -1, false, bucketWorkspaces[t]);
+      CopyRow(bucketWorkspaces[t], targets, row);
+    } else {
+      RunDijkstra(g, sources[i], -1, false, workspaces[t]);
+      CopyRow(workspaces[t], targets, row);
+    }
+  });
+}
+
+// Vertex ids of a graph renumbered by Graph::Renumber(), in both
+// directions. Both are empty if the graph keeps the ids of its file.
+struct VertexMap {
+  std::vector<unsigned int> toInternal;  // File id to graph id
+  std::vector<unsigned int> toExternal;  // Graph id to file id
 };
 
-Edge::Edge(unsigned int dest, double weight)
-    : edgeDestVertex(dest), weight(weight) {}
+// Answers every "src dst" line of @in against the already loaded @g.
+// Queries are read in blocks, answered by @engine and printed in input
+// order, with the ids of the graph file. The stats of each query go to
+// @report, if any.
+// Returns -1 if any line was invalid, 0 otherwise
+int RunBatch(const Graph &g, std::istream &in, ParallelQueryEngine &engine,
+             const VertexMap &ids, StatsReport *report) {
+  const unsigned int kBlockSize = 8192;
+  std::vector<ShortestPath> block;
+  std::string line;
+  int lineNumber = 0;
+  int status = 0;
+
+  for (;;) {
+    bool more = static_cast<bool>(std::getline(in, line));
+
+    if (!more || block.size() == kBlockSize) {
+      engine.Run(block);
+      for (ShortestPath &s : block) {
+        if (!ids.toExternal.empty())
+          s.Renumber(ids.toExternal);
+        if (report)
+          s.ReportStats(*report);
+        s.Print();
+      }
+      block.clear();
+    }
+    if (!more)
+      break;
+
+    int src, dst;
+    int result = ParseQuery(g, line, ++lineNumber, src, dst);
+    if (result == -1)
+      status = -1;
+    if (result != 0)
+      continue;
+
+    block.push_back(ShortestPath(src, dst));
+    if (!ids.toInternal.empty())
+      block.back().Renumber(ids.toInternal);
+  }
+
+  return status;
+}
+
+// Answers every "src dst" line of @in with plain Dijkstra on @g and on a
+// copy of @g that stores its weights as @Weight, and reports how far the
+// distances of the copy are from the exact ones
+// Returns -1 if the copy cannot be made or any line was invalid, 0 otherwise
+template <typename Weight>
+int CompareWeights(const BasicGraph<DoubleWeight> &g, std::istream &in,
+                   const std::string &name) {
+  BasicGraph<Weight> compact;
+  if (compact.CopyFrom(g) == -1)
+    return -1;
+
+  DijkstraWorkspace exactWs(g.GetNumVertices());
+  DijkstraWorkspace compactWs(g.GetNumVertices());
+  std::string line;
+  int lineNumber = 0;
+  int status = 0;
+  unsigned int numQueries = 0, otherPaths = 0, otherReach = 0;
+  double maxError = 0, maxRelError = 0;
+
+  while (std::getline(in, line)) {
+    int src, dst;
+    int result = ParseQuery(g, line, ++lineNumber, src, dst);
+    if (result == -1)
+      status = -1;
+    if (result != 0)
+      continue;
+
+    ShortestPath exact(src, dst), approx(src, dst);
+    exact.Dijkstra(g, exactWs);
+    approx.Dijkstra(compact, compactWs);
+    numQueries++;
+
+    if (exact.GetPath() != approx.GetPath())
+      otherPaths++;
+    if (exact.GetPath().empty() != approx.GetPath().empty()) {
+      otherReach++;
+      continue;
+    }
+    if (exact.GetPath().empty())
+      continue;
+
+    double error = std::fabs(approx.GetDistance() - exact.GetDistance());
+    maxError = std::max(maxError, error);
+    if (exact.GetDistance() > 0)
+      maxRelError = std::max(maxRelError, error / exact.GetDistance());
+  }
 
-unsigned int Edge::GetEdgeDest(void) {
-  return edgeDestVertex;
+  uint64_t edgeBytes = static_cast<uint64_t>(g.GetNumEdges())
+      * sizeof(BasicEdge<Weight>);
+  std::cout << "Weights " << name << ": " << sizeof(BasicEdge<Weight>)
+            << " bytes per edge instead of " << sizeof(BasicEdge<DoubleWeight>)
+            << ", " << edgeBytes << " bytes of edges" << '\n';
+  std::cout << numQueries << " queries, " << otherPaths
+            << " with another path, " << otherReach
+            << " with another reachability" << '\n';
+  std::cout << "Largest distance error " << maxError << ", relative "
+            << maxRelError << '\n';
+  return status;
 }
 
-double Edge::GetWeight(void) {
-  return weight;
+// Answers every "src dst" line of @in with plain Dijkstra on the
+// compressed graph @g, one query at a time
+// Returns -1 if any line was invalid, 0 otherwise
+int RunCompressedBatch(const CompressedGraph &g, std::istream &in) {
+  DijkstraWorkspace ws(g.GetNumVertices());
+  std::string line;
+  int lineNumber = 0;
+  int status = 0;
+
+  while (std::getline(in, line)) {
+    int src, dst;
+    int result = ParseQuery(g, line, ++lineNumber, src, dst);
+    if (result == -1)
+      status = -1;
+    if (result != 0)
+      continue;
+
+    ShortestPath path(src, dst);
+    path.Dijkstra(g, ws);
+    path.Print();
+  }
+  return status;
 }
 
-std::ostream& operator <<(std::ostream &os, Edge &e) {
-  os << "edgeDestVertex: " << e.edgeDestVertex << " ";
-  os << "edgeWeight: " << e.weight;
+// Applies the commands of @in to @g and to a shortest path tree kept
+// current under them:
+//   source s       roots the tree at s (full Dijkstra)
+//   insert u v w   adds the edge u -> v of weight w
+//   delete u v     removes an edge u -> v
+//   weight u v w   sets the weight of an edge u -> v to w
+//   path t         prints the path from the root to t
+// Needs the reverse adjacency of @g.
+// Returns -1 if any line was invalid, 0 otherwise
+int RunDynamic(Graph &g, std::istream &in) {
+  DynamicShortestPathTree tree(g.GetNumVertices());
+  bool rooted = false;
+  std::string line;
+  int lineNumber = 0;
+  int status = 0;
+
+  while (std::getline(in, line)) {
+    lineNumber++;
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
 
-  return os;
+    std::istringstream ss(line);
+    std::string command;
+    int u = -1, v = -1;
+    double w = 0;
+    bool valid;
+
+    ss >> command;
+    if (command == "source" || command == "path")
+      valid = static_cast<bool>(ss >> u);
+    else if (command == "delete")
+      valid = static_cast<bool>(ss >> u >> v);
+    else if (command == "insert" || command == "weight")
+      valid = static_cast<bool>(ss >> u >> v >> w);
+    else
+      valid = false;
+    if (!valid) {
+      std::cerr << "Error: invalid command on line " << lineNumber
+                << std::endl;
+      status = -1;
+      continue;
+    }
+
+    if (command == "source") {
+      if (!CheckQuery(g, u, u)) {
+        status = -1;
+        continue;
+      }
+      tree.Build(g, u);
+      rooted = true;
+      continue;
+    }
+    if (!rooted) {
+      std::cerr << "Error: no source before line " << lineNumber
+                << std::endl;
+      status = -1;
+      continue;
+    }
+
+    int result = 0;
+    if (command == "path") {
+      if (!CheckQuery(g, tree.GetSource(), u)) {
+        status = -1;
+        continue;
+      }
+      ShortestPath path(tree.GetSource(), u);
+      path.FromTree(tree);
+      path.Print();
+    } else if (command == "insert") {
+      result = tree.InsertEdge(g, u, v, w);
+    } else if (command == "delete") {
+      result = tree.DeleteEdge(g, u, v);
+    } else {
+      result = tree.SetEdgeWeight(g, u, v, w);
+    }
+    if (result == -1)
+      status = -1;
+  }
+
+  return status;
 }
 
-std::ostream& operator <<(std::ostream &os, Vertex &v) {
-  for (auto edge : v.vertex)
-    std::cout << edge << std::endl;
+// Command line settings besides the graph file
+struct Options {
+  std::string batchFile;  // Empty unless --batch was given
+  std::string dynamicFile;  // Empty unless --dynamic was given
+  std::string serveSocket;  // Empty unless --serve was given
+  int numThreads = 1;
+  SearchMode mode = kDijkstra;
+  int buildLandmarks = 0;  // Number of landmarks to preprocess, if any
+  bool buildHierarchy = false;
+  bool buildHubLabels = false;
+  int buildArcFlags = 0;  // Number of regions to preprocess, if any
+  double delta = 0;  // Delta-stepping bucket width, 0 for the default
+  int oneToAll = -1;  // Source of the full tree to write, if any
+  int oneToMany = -1;  // Source of the paths to the --targets, if any
+  std::string manyToMany;  // File of sources for a distance matrix
+  // Matrix columns (all vertices if empty), or --one-to-many destinations
+  std::string targetsFile;
+  std::string outFile;  // Standard output if empty
+  OutputFormat format = kTextFormat;
+  QueueKind queue = kBinaryHeap;
+  bool reorder = false;
+  VertexOrder order = kBfsOrder;
+  std::string compareWeights;  // "float" or "fixed" to compare, if any
+  size_t cacheBytes = 0;  // Budget of the shortest path tree cache, if any
+  int benchQueries = 0;  // Random queries per engine for --bench, if any
+  unsigned int seed = 1;  // Of the --bench queries
+  std::string stats;  // "query" or "total" for --stats, if any
+  std::vector<std::string> positional;
+};
 
-  return os;
+// Parses all of the option value @text with @parse, one of the field
+// parsers of EWD text, so that a bad number fails instead of throwing
+// Returns false if @text is not a number or has anything after it
+template <typename T>
+bool ParseNumber(const std::string &text,
+                 bool (*parse)(const char *&, const char *, T &), T &value) {
+  const char *p = text.data();
+  const char *end = p + text.size();
+  return parse(p, end, value) && p == end;
 }
 
-void Vertex::AddEdge(unsigned int edgeDestVertex, double edgeWeight) {
-  Edge edge(edgeDestVertex, edgeWeight);
-  vertex.push_back(edge);
+// Returns -1 on unknown, incomplete or invalid options, 0 otherwise
+int ParseOptions(int argc, char *argv[], Options &opts) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+
+    if (arg.size() < 3 || arg.compare(0, 2, "--") != 0) {
+      opts.positional.push_back(arg);
+      continue;
+    }
+
+    // Options without a value
+    if (arg == "--bidir") {
+      opts.mode = kBidirectional;
+      continue;
+    }
+    if (arg == "--alt") {
+      opts.mode = kLandmarks;
+      continue;
+    }
+    if (arg == "--ch") {
+      opts.mode = kHierarchy;
+      continue;
+    }
+    if (arg == "--delta-stepping") {
+      opts.mode = kDeltaStepping;
+      continue;
+    }
+    if (arg == "--hubs") {
+      opts.mode = kHubLabels;
+      continue;
+    }
+    if (arg == "--arc-flags") {
+      opts.mode = kArcFlags;
+      continue;
+    }
+    if (arg == "--build-ch") {
+      opts.buildHierarchy = true;
+      continue;
+    }
+    if (arg == "--build-hubs") {
+      opts.buildHubLabels = true;
+      continue;
+    }
+
+    if (i + 1 == argc)
+      return -1;
+
+    if (arg == "--batch") {
+      opts.batchFile = argv[++i];
+    } else if (arg == "--dynamic") {
+      opts.dynamicFile = argv[++i];
+    } else if (arg == "--serve") {
+      opts.serveSocket = argv[++i];
+    } else if (arg == "--threads") {
+      if (!ParseNumber(argv[++i], ParseIntField, opts.numThreads)
+          || opts.numThreads < 0)
+        return -1;
+      if (opts.numThreads == 0)
+        opts.numThreads = std::max(1u, std::thread::hardware_concurrency());
+    } else if (arg == "--build-landmarks") {
+      if (!ParseNumber(argv[++i], ParseIntField, opts.buildLandmarks)
+          || opts.buildLandmarks <= 0)
+        return -1;
+    } else if (arg == "--build-arc-flags") {
+      if (!ParseNumber(argv[++i], ParseIntField, opts.buildArcFlags)
+          || opts.buildArcFlags <= 0 || opts.buildArcFlags > kMaxRegions)
+        return -1;
+    } else if (arg == "--delta") {
+      if (!ParseNumber(argv[++i], ParseDoubleField, opts.delta)
+          || opts.delta <= 0)
+        return -1;
+    } else if (arg == "--one-to-all") {
+      if (!ParseNumber(argv[++i], ParseIntField, opts.oneToAll)
+          || opts.oneToAll < 0)
+        return -1;
+    } else if (arg == "--one-to-many") {
+      if (!ParseNumber(argv[++i], ParseIntField, opts.oneToMany)
+          || opts.oneToMany < 0)
+        return -1;
+    } else if (arg == "--many-to-many") {
+      opts.manyToMany = argv[++i];
+    } else if (arg == "--targets") {
+      opts.targetsFile = argv[++i];
+    } else if (arg == "--out") {
+      opts.outFile = argv[++i];
+    } else if (arg == "--queue") {
+      std::string name(argv[++i]);
+      if (name == "heap")
+        opts.queue = kBinaryHeap;
+      else if (name == "radix")
+        opts.queue = kRadixHeap;
+      else if (name == "dial")
+        opts.queue = kBucketQueue;
+      else
+        return -1;
+    } else if (arg == "--reorder") {
+      std::string name(argv[++i]);
+      opts.reorder = true;
+      if (name == "bfs")
+        opts.order = kBfsOrder;
+      else if (name == "rcm")
+        opts.order = kRcmOrder;
+      else
+        return -1;
+    } else if (arg == "--compare-weights") {
+      opts.compareWeights = argv[++i];
+      if (opts.compareWeights != "float" && opts.compareWeights != "fixed")
+        return -1;
+    } else if (arg == "--cache-mb") {
+      double megabytes;
+      if (!ParseNumber(argv[++i], ParseDoubleField, megabytes)
+          || megabytes <= 0 || megabytes * (1 << 20) >= SIZE_MAX)
+        return -1;
+      opts.cacheBytes = megabytes * (1 << 20);
+    } else if (arg == "--bench") {
+      if (!ParseNumber(argv[++i], ParseIntField, opts.benchQueries)
+          || opts.benchQueries <= 0)
+        return -1;
+    } else if (arg == "--seed") {
+      // A minus sign would wrap around
+      std::string seed(argv[++i]);
+      if (seed[0] == '-' || !ParseNumber(seed, ParseUnsignedField, opts.seed))
+        return -1;
+    } else if (arg == "--stats") {
+      opts.stats = argv[++i];
+      if (opts.stats != "query" && opts.stats != "total")
+        return -1;
+    } else if (arg == "--format") {
+      if (ParseOutputFormat(argv[++i], opts.format) == -1)
+        return -1;
+    } else {
+      return -1;
+    }
+  }
+  return 0;
 }
 
-// Extracts file contents to construct graph
-// Returns -1 if file cannot be open or there are input errors
-// Returns 0 if file successfully read
-int Graph::ExtractFile(const std::string &fileName) {
+void PrintUsage(const char *prog) {
+  std::cerr << "Usage: " << prog << " <graph.dat> src dst [mode]"
+            << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --batch <queries|->"
+            << " [--threads N] [mode]" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --dynamic <commands|->"
+            << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --serve <socket>"
+            << " [--threads N] [mode]" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --build-landmarks K"
+            << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --build-ch" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --build-hubs" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --build-arc-flags K"
+            << " (at most " << kMaxRegions << " regions)" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --batch <queries|->"
+            << " --compare-weights float|fixed" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --bench N [--seed S]"
+            << " [--threads N] [--delta D]" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --one-to-all src"
+            << " [--out F] [--format text|binary] [mode]" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --one-to-many src"
+            << " --targets <targets> [--out F] [mode]" << std::endl;
+  std::cerr << "       " << prog << " <graph.dat> --many-to-many <sources>"
+            << " [--targets <targets>] [--threads N]" << std::endl;
+  std::cerr << "           [--out F] [--format text|binary] [mode]"
+            << std::endl;
+  std::cerr << "Modes: --bidir (bidirectional Dijkstra), --alt (A* with the"
+            << " landmarks of <graph.dat>.alt)," << std::endl;
+  std::cerr << "       --ch (contraction hierarchy of <graph.dat>.ch),"
+            << std::endl;
+  std::cerr << "       --hubs (hub labels of <graph.dat>.hl; distances only"
+            << " with --many-to-many)," << std::endl;
+  std::cerr << "       --arc-flags (Dijkstra on the edges flagged in"
+            << " <graph.dat>.af)," << std::endl;
+  std::cerr << "       --delta-stepping [--delta D] (parallel full search,"
+            << " --threads per query)," << std::endl;
+  std::cerr << "       --queue heap|radix|dial (priority queue of plain"
+            << " Dijkstra)" << std::endl;
+  std::cerr << "Single and batch queries of Dijkstra, --bidir and"
+            << " --delta-stepping take" << std::endl;
+  std::cerr << "       --reorder bfs|rcm (renumber the vertices for"
+            << " locality after loading)" << std::endl;
+  std::cerr << "Batch and --serve queries of Dijkstra take --cache-mb M"
+            << " (keep the full trees of" << std::endl;
+  std::cerr << "       recent sources in M MB and answer their queries from"
+            << " them)" << std::endl;
+  std::cerr << "--bench runs N random queries through every mode and queue"
+            << " whose index files exist," << std::endl;
+  std::cerr << "       and prints a CSV line for each: throughput over the"
+            << " threads, then the" << std::endl;
+  std::cerr << "       latency and vertices settled of the queries one at a"
+            << " time, and the peak RSS" << std::endl;
+  std::cerr << "Single and batch queries of Dijkstra take --stats"
+            << " query|total (JSON search counters" << std::endl;
+  std::cerr << "       and phase times on stderr, per query or summed up;"
+            << " needs make STATS=1)" << std::endl;
+  std::cerr << "Graphs compressed by ewd_to_bin --compress answer single and"
+            << " batch queries" << std::endl;
+  std::cerr << "       with plain Dijkstra" << std::endl;
+}
+
+// Reads the whitespace separated vertex ids of @fileName into @ids
+// Returns -1 if the file cannot be read or holds anything but vertices of
+// @g, 0 otherwise
+int ReadVertexList(const Graph &g, const std::string &fileName,
+                   std::vector<unsigned int> &ids) {
   std::ifstream myfile(fileName);
 
   if (myfile.fail()) {
@@ -93,150 +762,752 @@ int Graph::ExtractFile(const std::string &fileName) {
     return -1;
   }
 
-  unsigned int edgeSourceVertex, edgeDestVertex;
-  double edgeWeight;
+  int v;
+  ids.clear();
+  while (myfile >> v) {
+    if (v < 0 || v >= g.GetNumVertices()) {
+      std::cerr << "Error: invalid vertex " << v << " in file " << fileName
+                << std::endl;
+      return -1;
+    }
+    ids.push_back(v);
+  }
+  if (!myfile.eof()) {
+    std::cerr << "Error: invalid vertex list " << fileName << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+// Writes the full shortest path tree from @source to @os
+// Returns -1 if @source is not a vertex of @g, 0 otherwise
+int RunOneToAll(const Graph &g, int source, const Options &opts,
+                const SearchIndex &index, std::ostream &os) {
+  if (!CheckQuery(g, source, source))
+    return -1;
 
-  if (myfile >> numVertices) {
-    Vertex v;
-    AdjList.resize(numVertices, v);
-  } else {  // There are no vertices in the graph
-    std::cerr << "Error: invalid graph size" << std::endl;
+  if (opts.mode == kDeltaStepping) {
+    DeltaStepping ds(g, index.delta, opts.numThreads);
+    ds.Run(source);
+    WriteTree(os, opts.format, source, g.GetNumVertices(), ds);
+  } else if (index.queue == kRadixHeap) {
+    RadixWorkspace ws(g.GetNumVertices());
+    RunDijkstra(g, source, -1, false, ws);
+    WriteTree(os, opts.format, source, g.GetNumVertices(), ws);
+  } else if (index.queue == kBucketQueue) {
+    BucketWorkspace ws(g.GetNumVertices(),
+                       BucketQueue<double>(g.GetNumVertices(),
+                                           index.minWeight, index.maxWeight));
+    RunDijkstra(g, source, -1, false, ws);
+    WriteTree(os, opts.format, source, g.GetNumVertices(), ws);
+  } else {
+    DijkstraWorkspace ws(g.GetNumVertices());
+    RunDijkstra(g, source, -1, false, ws);
+    WriteTree(os, opts.format, source, g.GetNumVertices(), ws);
+  }
+  return 0;
+}
+
+// Writes the paths from @source to every --targets vertex to @os, in the
+// order of the targets file. Dijkstra stops once they are all settled;
+// delta-stepping always searches the whole graph.
+// Returns -1 on invalid input, 0 otherwise
+int RunOneToMany(const Graph &g, int source, const Options &opts,
+                 const SearchIndex &index, std::ostream &os) {
+  std::vector<unsigned int> targets;
+
+  if (!CheckQuery(g, source, source))
+    return -1;
+  if (ReadVertexList(g, opts.targetsFile, targets) == -1)
     return -1;
+
+  std::vector<ShortestPath> paths;
+  for (unsigned int t : targets)
+    paths.push_back(ShortestPath(source, t));
+
+  if (opts.mode == kDeltaStepping) {
+    DeltaStepping ds(g, index.delta, opts.numThreads);
+    ds.Run(source);
+    for (ShortestPath &path : paths)
+      path.FromLabels(ds);
+  } else if (index.queue == kRadixHeap) {
+    RadixWorkspace ws(g.GetNumVertices());
+    ShortestPath::MultiTargetDijkstra(g, paths, ws);
+  } else if (index.queue == kBucketQueue) {
+    BucketWorkspace ws(g.GetNumVertices(),
+                       BucketQueue<double>(g.GetNumVertices(),
+                                           index.minWeight, index.maxWeight));
+    ShortestPath::MultiTargetDijkstra(g, paths, ws);
+  } else {
+    DijkstraWorkspace ws(g.GetNumVertices());
+    ShortestPath::MultiTargetDijkstra(g, paths, ws);
   }
 
-  while (myfile >> edgeSourceVertex >> edgeDestVertex >> edgeWeight) {
-    if (edgeSourceVertex >= AdjList.size()) {
-      std::cerr << "Invalid source vertex number ";
-      std::cerr << edgeSourceVertex << std::endl;
+  for (ShortestPath &path : paths)
+    path.Print(os);
+  return 0;
+}
+
+// Writes the distances from every vertex of the --many-to-many file to
+// every --targets vertex to @os. Sources are searched in parallel a block
+// of rows at a time, and each block is written out before the next one, so
+// memory stays bounded however many sources there are.
+// Returns -1 on error, 0 otherwise
+int RunManyToMany(const Graph &g, const Options &opts,
+                  const SearchIndex &index, std::ostream &os) {
+  const size_t kBlockBytes = 64 << 20;
+  std::vector<unsigned int> sources, targets;
+
+  if (ReadVertexList(g, opts.manyToMany, sources) == -1)
+    return -1;
+  if (opts.targetsFile.empty()) {
+    for (int v = 0; v < g.GetNumVertices(); v++)
+      targets.push_back(v);
+  } else if (ReadVertexList(g, opts.targetsFile, targets) == -1) {
+    return -1;
+  }
+
+  size_t rowBytes = std::max<size_t>(1, targets.size()) * sizeof(double);
+  size_t blockRows = std::max<size_t>(kBlockBytes / rowBytes,
+                                      opts.numThreads);
+  ParallelQueryEngine engine(g, opts.numThreads, opts.mode, index);
+  MatrixWriter writer(os, opts.format);
+  std::vector<unsigned int> block;
+  std::vector<double> rows;
+
+  writer.WriteHeader(sources, targets);
+  for (size_t first = 0; first < sources.size(); first += blockRows) {
+    size_t last = std::min(first + blockRows, sources.size());
+    block.assign(sources.begin() + first, sources.begin() + last);
+    engine.RunRows(block, targets, rows);
+    for (size_t i = 0; i < block.size(); i++)
+      writer.WriteRow(block[i], rows.data() + i * targets.size());
+  }
+  return 0;
+}
+
+// Runs the --one-to-all, --one-to-many or --many-to-many search, writing
+// to --out or to standard output
+// Returns -1 on error, 0 otherwise
+int RunFullSearch(const Graph &g, const Options &opts,
+                  const SearchIndex &index) {
+  std::ofstream file;
+  std::ostream *os = &std::cout;
+
+  if (!opts.outFile.empty()) {
+    file.open(opts.outFile, std::ios::binary | std::ios::trunc);
+    if (file.fail()) {
+      std::cerr << "Error: cannot open file " << opts.outFile << std::endl;
       return -1;
     }
+    os = &file;
+  }
 
-    if (edgeDestVertex >= AdjList.size()) {
-      std::cerr << "Invalid dest vertex number " << edgeDestVertex << std::endl;
-      return -1;
+  int status;
+  if (opts.oneToAll != -1)
+    status = RunOneToAll(g, opts.oneToAll, opts, index, *os);
+  else if (opts.oneToMany != -1)
+    status = RunOneToMany(g, opts.oneToMany, opts, index, *os);
+  else
+    status = RunManyToMany(g, opts, index, *os);
+
+  if (status == 0 && !os->flush()) {
+    std::cerr << "Error: cannot write "
+              << (opts.outFile.empty() ? "output" : opts.outFile) << std::endl;
+    return -1;
+  }
+  return status;
+}
+
+// Sets the bucket queue parameters of @index from the edge weights of @g
+// Returns -1 if the weights do not suit a bucket queue, 0 otherwise
+int SetBucketRange(const Graph &g, SearchIndex &index) {
+  const double kMaxBuckets = 1 << 24;
+  double minWeight = std::numeric_limits<double>::max();
+  double maxWeight = 0;
+
+  for (int u = 0; u < g.GetNumVertices(); u++) {
+    for (const Edge &e : g.GetEdges(u)) {
+      minWeight = std::min(minWeight, e.GetWeight());
+      maxWeight = std::max(maxWeight, e.GetWeight());
     }
+  }
+  if (g.GetNumEdges() == 0)
+    minWeight = 1;
 
-    if (edgeWeight < 0) {
-      std::cerr << "Invalid weight " << edgeWeight << std::endl;
+  if (minWeight <= 0) {
+    std::cerr << "Error: --queue dial needs positive edge weights"
+              << std::endl;
+    return -1;
+  }
+  if (maxWeight / minWeight > kMaxBuckets) {
+    std::cerr << "Error: edge weights are too spread out for --queue dial"
+              << std::endl;
+    return -1;
+  }
+  index.minWeight = minWeight;
+  index.maxWeight = maxWeight;
+  return 0;
+}
+
+// Runs the --compare-weights mode on the batch queries of @opts. The
+// reference graph always stores doubles, whatever Graph stores.
+// Returns -1 on invalid input, 0 otherwise
+int RunCompareWeights(const std::string &graphFile, const Options &opts) {
+  BasicGraph<DoubleWeight> g;
+  if (g.Load(graphFile) == -1)
+    return -1;
+
+  std::ifstream queries;
+  if (opts.batchFile != "-") {
+    queries.open(opts.batchFile);
+    if (queries.fail()) {
+      std::cerr << "Error: cannot open file " << opts.batchFile << std::endl;
       return -1;
     }
+  }
+  std::istream &in = opts.batchFile == "-" ? std::cin : queries;
 
-    AdjList[edgeSourceVertex].AddEdge(edgeDestVertex, edgeWeight);
-    numEdges++;
+  if (opts.compareWeights == "float")
+    return CompareWeights<FloatWeight>(g, in, opts.compareWeights);
+  return CompareWeights<FixedWeight>(g, in, opts.compareWeights);
+}
+
+// Answers the single query or the batch of @opts on the compressed graph
+// file @graphFile
+// Returns -1 on invalid input, 0 otherwise
+int RunCompressed(const std::string &graphFile, const Options &opts) {
+  CompressedGraph g;
+  if (g.Load(graphFile) == -1)
+    return -1;
+
+  if (opts.batchFile.empty()) {
+    int src = std::stoi(opts.positional[1]);
+    int dst = std::stoi(opts.positional[2]);
+    if (!CheckQuery(g, src, dst))
+      return -1;
+
+    DijkstraWorkspace ws(g.GetNumVertices());
+    ShortestPath path(src, dst);
+    path.Dijkstra(g, ws);
+    path.Print();
+    return 0;
   }
 
-  myfile.close();
+  std::ios::sync_with_stdio(false);
+  if (opts.batchFile == "-")
+    return RunCompressedBatch(g, std::cin);
 
-  return 0;
+  std::ifstream queries(opts.batchFile);
+  if (queries.fail()) {
+    std::cerr << "Error: cannot open file " << opts.batchFile << std::endl;
+    return -1;
+  }
+  return RunCompressedBatch(g, queries);
 }
 
-int Graph::GetNumVertices(void) {
-  return numVertices;
-}
+// Answers the queries of the clients of the UNIX socket @socketPath with
+// @engine, one worker per engine thread, until interrupted
+// Returns -1 on error, 0 otherwise
+int RunServer(const Graph &g, ParallelQueryEngine &engine, int numThreads,
+              const std::string &socketPath, const VertexMap &ids) {
+  QueryServer server(g.GetNumVertices(), numThreads,
+                     [&engine, &ids](unsigned int src, unsigned int dst,
+                                     unsigned int worker,
+                                     QueryResult &result) {
+                       ShortestPath path(src, dst);
+                       if (!ids.toInternal.empty())
+                         path.Renumber(ids.toInternal);
+                       engine.Answer(path, worker);
+                       if (!ids.toExternal.empty())
+                         path.Renumber(ids.toExternal);
+                       result.distance = path.GetDistance();
+                       result.path = path.GetPath();
+                     });
 
-std::vector<Vertex>& Graph::GetAdjList(void) {
-  return AdjList;
+  if (server.Listen(socketPath) == -1)
+    return -1;
+  return server.Run();
 }
 
-void Graph::Print(void) {
-  int index = 0;
+// Query engine run by the benchmark: a search mode, with its queue for
+// plain Dijkstra
+struct BenchEngine {
+  const char *name;
+  SearchMode mode;
+  QueueKind queue;
+};
 
-  for (auto v : AdjList) {
-    std::cout << "At vertex " << index << ", adjacent edges are:" << std::endl;
-    std::cout << v << std::endl;
-    index++;
-  }
+// Peak resident set size of the process so far, in KB
+long GetPeakRss(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == -1)
+    return 0;
+  return usage.ru_maxrss;
 }
 
-ShortestPath::ShortestPath(int sourceVertex, int destVertex) :
-    sourceVertex(sourceVertex),  destVertex(destVertex) {}
+// Loads the index of @g saved in @fileName into @index, if the file exists
+// Returns -1 if it exists but does not load, 0 otherwise
+template <typename Index>
+int LoadBenchIndex(const Graph &g, const std::string &fileName,
+                   Index &index, const Index *&indexPointer) {
+  if (!std::ifstream(fileName)) {
+    std::cerr << "Skipping " << fileName << ": no such file" << std::endl;
+    return 0;
+  }
+  if (index.Load(fileName, g) == -1)
+    return -1;
+  indexPointer = &index;
+  return 0;
+}
 
-// Dijkstra's algorithm for finding shortest path in a graph
-void ShortestPath::Dijkstra(Graph &g) {
-  IndexMinPQ<double> Q(g.GetNumVertices());
+// Runs the same random queries through every engine @g has the index
+// files for, and prints a CSV line per engine. Distances that differ from
+// those of plain Dijkstra are counted as mismatches.
+// Returns -1 if an index file is invalid, 0 otherwise
+int RunBench(Graph &g, const std::string &graphFile, const Options &opts) {
+  const BenchEngine kEngines[] = {
+    {"dijkstra", kDijkstra, kBinaryHeap},
+    {"dijkstra-radix", kDijkstra, kRadixHeap},
+    {"dijkstra-dial", kDijkstra, kBucketQueue},
+    {"bidir", kBidirectional, kBinaryHeap},
+    {"alt", kLandmarks, kBinaryHeap},
+    {"ch", kHierarchy, kBinaryHeap},
+    {"hubs", kHubLabels, kBinaryHeap},
+    {"arc-flags", kArcFlags, kBinaryHeap},
+    {"delta-stepping", kDeltaStepping, kBinaryHeap},
+  };
+  typedef std::chrono::steady_clock Clock;
 
-  std::vector<double> dist(g.GetNumVertices(),
-    std::numeric_limits<double>::max());
+  if (g.GetNumVertices() == 0) {
+    std::cerr << "Error: --bench needs a graph with vertices" << std::endl;
+    return -1;
+  }
+  g.BuildReverse();
 
-  std::vector<int> prev(g.GetNumVertices(), -1);
+  SearchIndex index;
+  Landmarks landmarks;
+  ContractionHierarchy hierarchy;
+  HubLabels hubLabels;
+  ArcFlags arcFlags;
+  if (LoadBenchIndex(g, graphFile + ".alt", landmarks, index.landmarks) == -1
+      || LoadBenchIndex(g, graphFile + ".ch", hierarchy,
+                        index.hierarchy) == -1
+      || LoadBenchIndex(g, graphFile + ".hl", hubLabels,
+                        index.hubLabels) == -1
+      || LoadBenchIndex(g, graphFile + ".af", arcFlags,
+                        index.arcFlags) == -1)
+    return -1;
+  index.delta = opts.delta ? opts.delta : DeltaStepping::DefaultDelta(g);
+  bool hasDelta = DeltaStepping::CheckDelta(g, index.delta) == 0;
+  bool hasBuckets = SetBucketRange(g, index) == 0;
 
-  dist[sourceVertex] = 0;
+  std::mt19937 rng(opts.seed);
+  std::uniform_int_distribution<int> vertex(0, g.GetNumVertices() - 1);
+  std::vector<ShortestPath> queries;
+  for (int i = 0; i < opts.benchQueries; i++) {
+    int src = vertex(rng);
+    queries.push_back(ShortestPath(src, vertex(rng)));
+  }
 
-  Q.Push(dist[sourceVertex], sourceVertex);
+  std::cout << "graph,vertices,edges,engine,threads,queries,qps,p50_us,"
+            << "p99_us,settled_per_query,peak_rss_kb,mismatches\n";
+  std::cout << std::fixed << std::setprecision(1);
+  std::vector<double> reference;
+  for (const BenchEngine &engine : kEngines) {
+    if ((engine.mode == kLandmarks && !index.landmarks)
+        || (engine.mode == kHierarchy && !index.hierarchy)
+        || (engine.mode == kHubLabels && !index.hubLabels)
+        || (engine.mode == kArcFlags && !index.arcFlags)
+        || (engine.mode == kDeltaStepping && !hasDelta)
+        || (engine.queue == kBucketQueue && !hasBuckets))
+      continue;
+    index.queue = engine.queue;
+    ParallelQueryEngine queryEngine(g, opts.numThreads, engine.mode, index);
 
-  while (Q.Size()) {
-    int u = Q.Top();
-    Q.Pop();
+    // Throughput of the whole batch over all threads
+    std::vector<ShortestPath> paths(queries);
+    Clock::time_point start = Clock::now();
+    queryEngine.Run(paths);
+    std::chrono::duration<double> batchTime = Clock::now() - start;
 
-    if (u == destVertex) {
-      break;
+    // Then latency, one query at a time on one thread
+    std::vector<double> micros;
+    uint64_t numSettled = queryEngine.GetNumSettled();
+    for (ShortestPath &query : queries) {
+      std::vector<ShortestPath> one(1, query);
+      start = Clock::now();
+      if (engine.mode == kDeltaStepping)
+        queryEngine.Run(one);
+      else
+        queryEngine.Answer(one[0], 0);
+      std::chrono::duration<double, std::micro> elapsed =
+          Clock::now() - start;
+      micros.push_back(elapsed.count());
     }
-    for (Edge e : g.GetAdjList()[u].vertex) {
-      double alt = dist[u] + e.GetWeight();
-      if (alt < dist[e.GetEdgeDest()]) {
-        dist[e.GetEdgeDest()] = alt;
-        prev[e.GetEdgeDest()] = u;
+    numSettled = queryEngine.GetNumSettled() - numSettled;
+    std::sort(micros.begin(), micros.end());
 
-        if (Q.Contains(e.GetEdgeDest()))
-          Q.ChangeKey(dist[e.GetEdgeDest()], e.GetEdgeDest());
-        else
-          Q.Push(dist[e.GetEdgeDest()], e.GetEdgeDest());
-      }
+    int mismatches = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+      double dist = paths[i].GetDistance();
+      if (reference.size() < paths.size())
+        reference.push_back(dist);
+      else if (dist != reference[i]
+               && !(std::abs(dist - reference[i]) <= 1e-9 * reference[i]))
+        mismatches++;
     }
-  }
 
-  int u = destVertex;
-  if (dist[u] != std::numeric_limits<double>::max()) {
-    while (u != -1) {
-      shortestPath.push_back(u);
-      u = prev[u];
-    }
+    std::cout << graphFile << "," << g.GetNumVertices() << ","
+              << g.GetNumEdges() << "," << engine.name << ","
+              << opts.numThreads << "," << queries.size() << ","
+              << queries.size() / batchTime.count() << ","
+              << micros[micros.size() / 2] << ","
+              << micros[micros.size() * 99 / 100] << ","
+              << static_cast<double>(numSettled) / queries.size() << ","
+              << GetPeakRss() << "," << mismatches << std::endl;
   }
-  shortestDistance = dist[destVertex];
+  return 0;
 }
 
-void ShortestPath::Print(void) {
-  std::cout << sourceVertex << " to " << destVertex << ": ";
-  if (shortestPath.empty()) {
-    std::cout << "no path" << std::endl;
-    return;
-  }
+// Reports how well @cache did on standard error
+void PrintCacheStats(const TreeCache &cache) {
+  std::cerr << "Tree cache: " << cache.GetNumHits() << " hits, "
+            << cache.GetNumMisses() << " misses, " << cache.GetNumEvictions()
+            << " evictions, " << cache.GetNumTrees() << " trees in "
+            << cache.GetNumBytes() / double(1 << 20) << " MB" << std::endl;
+}
 
-  for (auto i = shortestPath.size() - 1; i >= 1; i--) {
-    std::cout << shortestPath.at(i) << " => ";
-  }
-  std::cout << shortestPath.front() << " (";
-  std::cout << shortestDistance << ')' << std::endl;
+// Renumbers @g in @order and fills @ids with the id tables. Reports how
+// far apart the ends of the edges are before and after.
+void ReorderGraph(Graph &g, VertexOrder order, VertexMap &ids) {
+  unsigned int bandwidth;
+  double mean;
+
+  EdgeSpan(g, bandwidth, mean);
+  std::cerr << "Reorder " << (order == kBfsOrder ? "bfs" : "rcm")
+            << ": bandwidth " << bandwidth << ", mean edge span " << mean;
+
+  ids.toInternal = ComputeOrder(g, order);
+  ids.toExternal.resize(ids.toInternal.size());
+  for (size_t u = 0; u < ids.toInternal.size(); u++)
+    ids.toExternal[ids.toInternal[u]] = u;
+  g.Renumber(ids.toInternal);
+
+  EdgeSpan(g, bandwidth, mean);
+  std::cerr << " -> bandwidth " << bandwidth << ", mean edge span " << mean
+            << std::endl;
+}
+
+// Precomputes @k landmarks for @g and saves them next to @graphFile
+// Returns -1 on error, 0 otherwise
+int BuildLandmarks(Graph &g, const std::string &graphFile, int k) {
+  Landmarks lm;
+
+  g.BuildReverse();
+  lm.Build(g, k);
+  if (lm.Save(graphFile + ".alt") == -1)
+    return -1;
+
+  std::cout << graphFile << ".alt: " << lm.GetNumLandmarks()
+            << " landmarks" << std::endl;
+  return 0;
+}
+
+// Contracts @g and saves the hierarchy next to @graphFile
+// Returns -1 on error, 0 otherwise
+int BuildHierarchy(const Graph &g, const std::string &graphFile) {
+  ContractionHierarchy ch;
+
+  ch.Build(g);
+  if (ch.Save(graphFile + ".ch") == -1)
+    return -1;
+
+  std::cout << graphFile << ".ch: " << ch.GetNumShortcuts()
+            << " shortcuts" << std::endl;
+  return 0;
+}
+
+// Labels every vertex of @g with its hubs and saves the labels next to
+// @graphFile
+// Returns -1 on error, 0 otherwise
+int BuildHubLabels(Graph &g, const std::string &graphFile) {
+  HubLabels hl;
+
+  g.BuildReverse();
+  hl.Build(g);
+  if (hl.Save(graphFile + ".hl") == -1)
+    return -1;
+
+  std::cout << graphFile << ".hl: " << hl.GetAverageLabelSize()
+            << " hubs per label" << std::endl;
+  return 0;
+}
+
+// Partitions @g into @k regions, flags its edges and saves the flags next
+// to @graphFile
+// Returns -1 on error, 0 otherwise
+int BuildArcFlags(Graph &g, const std::string &graphFile, int k) {
+  ArcFlags af;
+
+  g.BuildReverse();
+  af.Build(g, k);
+  if (af.Save(graphFile + ".af") == -1)
+    return -1;
+
+  std::cout << graphFile << ".af: " << af.GetNumRegions() << " regions, "
+            << 100 * af.GetFlagDensity() << "% of the flags set" << std::endl;
+  return 0;
 }
 
 int main(int argc, char *argv[]) {
-  if (argc < 3) {
-    std::cerr << "Usage: " << argv[0] << " <graph.dat> src dst" << std::endl;
+  Options opts;
+
+  if (ParseOptions(argc, argv, opts) == -1) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  // A single query takes src and dst after the graph file
+  bool preprocess = opts.buildLandmarks || opts.buildHierarchy
+      || opts.buildHubLabels || opts.buildArcFlags;
+  bool fullSearch = opts.oneToAll != -1 || opts.oneToMany != -1
+      || !opts.manyToMany.empty();
+  bool dynamic = !opts.dynamicFile.empty();
+  bool serve = !opts.serveSocket.empty();
+  bool bench = opts.benchQueries > 0;
+  bool single = opts.batchFile.empty() && !preprocess && !fullSearch
+      && !dynamic && !serve && !bench;
+  if (opts.positional.size() != (single ? 3 : 1)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  if (opts.queue != kBinaryHeap && opts.mode != kDijkstra) {
+    std::cerr << "Error: --queue only applies to plain Dijkstra" << std::endl;
+    return 1;
+  }
+  if (dynamic && (opts.mode != kDijkstra || opts.queue != kBinaryHeap)) {
+    std::cerr << "Error: --dynamic only runs plain Dijkstra" << std::endl;
+    return 1;
+  }
+  if (serve && (!opts.batchFile.empty() || preprocess || fullSearch
+                || dynamic || opts.mode == kDeltaStepping)) {
+    std::cerr << "Error: --serve only answers queries of its clients, and"
+              << " not with --delta-stepping" << std::endl;
+    return 1;
+  }
+  if (bench && (!opts.batchFile.empty() || preprocess || fullSearch
+                || dynamic || serve || opts.mode != kDijkstra
+                || opts.queue != kBinaryHeap || opts.reorder
+                || !opts.compareWeights.empty() || opts.cacheBytes)) {
+    std::cerr << "Error: --bench runs every mode by itself, and only takes"
+              << " --seed, --threads and --delta" << std::endl;
+    return 1;
+  }
+  if (opts.cacheBytes && (opts.mode != kDijkstra
+                          || (opts.batchFile.empty() && !serve)
+                          || !opts.compareWeights.empty())) {
+    std::cerr << "Error: --cache-mb only applies to batch and --serve"
+              << " queries of plain Dijkstra" << std::endl;
+    return 1;
+  }
+  if (!opts.stats.empty() && !kSearchStats) {
+    std::cerr << "Error: --stats needs a build with make STATS=1"
+              << std::endl;
+    return 1;
+  }
+  if (!opts.stats.empty() && ((!single && opts.batchFile.empty())
+                              || opts.mode != kDijkstra || opts.cacheBytes
+                              || !opts.compareWeights.empty())) {
+    std::cerr << "Error: --stats only applies to single and batch queries"
+              << " of plain Dijkstra, without --cache-mb" << std::endl;
+    return 1;
+  }
+  if (fullSearch && opts.mode != kDijkstra && opts.mode != kDeltaStepping
+      && (opts.mode != kHubLabels || opts.manyToMany.empty())) {
+    std::cerr << "Error: --one-to-all, --one-to-many and --many-to-many"
+              << " only run Dijkstra or --delta-stepping, and"
+              << " --many-to-many --hubs" << std::endl;
     return 1;
   }
+  if (opts.oneToMany != -1
+      && (opts.targetsFile.empty() || opts.format != kTextFormat)) {
+    std::cerr << "Error: --one-to-many needs --targets and prints text"
+              << std::endl;
+    return 1;
+  }
+  if (opts.reorder && (preprocess || fullSearch || dynamic
+                       || opts.mode == kLandmarks
+                       || opts.mode == kHierarchy
+                       || opts.mode == kHubLabels
+                       || opts.mode == kArcFlags)) {
+    std::cerr << "Error: --reorder only applies to single and batch queries"
+              << " without --alt, --ch, --hubs or --arc-flags" << std::endl;
+    return 1;
+  }
+
+  if (CompressedGraph::IsCompressedFile(opts.positional[0])) {
+    if (preprocess || fullSearch || dynamic || serve
+        || opts.mode != kDijkstra || opts.queue != kBinaryHeap
+        || opts.reorder || !opts.compareWeights.empty()
+        || opts.cacheBytes || bench || !opts.stats.empty()) {
+      std::cerr << "Error: compressed graphs only answer single and batch"
+                << " queries with plain Dijkstra" << std::endl;
+      return 1;
+    }
+    return RunCompressed(opts.positional[0], opts) == -1 ? 1 : 0;
+  }
+  if (!opts.compareWeights.empty()) {
+    if (opts.batchFile.empty() || opts.mode != kDijkstra
+        || opts.queue != kBinaryHeap || opts.reorder) {
+      std::cerr << "Error: --compare-weights needs --batch and plain"
+                << " Dijkstra" << std::endl;
+      return 1;
+    }
+    return RunCompareWeights(opts.positional[0], opts) == -1 ? 1 : 0;
+  }
 
   Graph graph;
+  const std::string &graphFile = opts.positional[0];
 
-  if (graph.ExtractFile(argv[1]) == -1)
+  PhaseTimer loadTimer;
+  if (graph.Load(graphFile) == -1)
     return 1;
-  if (static_cast<int>(graph.GetAdjList().size()) <= std::stoi(argv[2])
-      || std::stoi(argv[2]) < 0) {
-    std::cerr << "Error: invalid source vertex number ";
-    std::cerr << std::stoi(argv[2]) << std::endl;
+  StatsReport report(std::cerr, opts.stats == "query", loadTimer.Lap());
+  StatsReport *statsReport = opts.stats.empty() ? nullptr : &report;
+
+  if (opts.buildLandmarks
+      && BuildLandmarks(graph, graphFile, opts.buildLandmarks) == -1)
+    return 1;
+  if (opts.buildHierarchy && BuildHierarchy(graph, graphFile) == -1)
+    return 1;
+  if (opts.buildHubLabels && BuildHubLabels(graph, graphFile) == -1)
     return 1;
+  if (opts.buildArcFlags
+      && BuildArcFlags(graph, graphFile, opts.buildArcFlags) == -1)
+    return 1;
+  if (preprocess)
+    return 0;
+  if (bench)
+    return RunBench(graph, graphFile, opts) == -1 ? 1 : 0;
+
+  VertexMap ids;
+  if (opts.reorder)
+    ReorderGraph(graph, opts.order, ids);
+
+  SearchIndex index;
+  Landmarks landmarks;
+  ContractionHierarchy hierarchy;
+  HubLabels hubLabels;
+  ArcFlags arcFlags;
+  if (opts.mode == kBidirectional)
+    graph.BuildReverse();
+  if (opts.mode == kLandmarks) {
+    if (landmarks.Load(graphFile + ".alt", graph) == -1)
+      return 1;
+    index.landmarks = &landmarks;
   }
-  if (static_cast<int>(graph.GetAdjList().size()) <= std::stoi(argv[3])
-      || std::stoi(argv[3]) < 0) {
-    std::cerr << "Error: invalid dest vertex number ";
-    std::cerr << std::stoi(argv[3]) << std::endl;
+  if (opts.mode == kHierarchy) {
+    if (hierarchy.Load(graphFile + ".ch", graph) == -1)
+      return 1;
+    index.hierarchy = &hierarchy;
+  }
+  if (opts.mode == kHubLabels) {
+    if (hubLabels.Load(graphFile + ".hl", graph) == -1)
+      return 1;
+    index.hubLabels = &hubLabels;
+  }
+  if (opts.mode == kArcFlags) {
+    if (arcFlags.Load(graphFile + ".af", graph) == -1)
+      return 1;
+    index.arcFlags = &arcFlags;
+  }
+  if (opts.mode == kDeltaStepping) {
+    index.delta = opts.delta;
+    if (index.delta == 0)
+      index.delta = DeltaStepping::DefaultDelta(graph);
+    if (DeltaStepping::CheckDelta(graph, index.delta) == -1)
+      return 1;
+  }
+  index.queue = opts.queue;
+  TreeCache treeCache(opts.cacheBytes);
+  if (opts.cacheBytes) {
+    size_t treeBytes = sizeof(ShortestPathTree)
+        + graph.GetNumVertices() * (sizeof(double) + sizeof(int));
+    if (treeBytes > opts.cacheBytes) {
+      std::cerr << "Error: --cache-mb is too small for one tree of "
+                << treeBytes / double(1 << 20) << " MB" << std::endl;
+      return 1;
+    }
+    index.treeCache = &treeCache;
+  }
+  if (opts.queue == kBucketQueue && SetBucketRange(graph, index) == -1)
     return 1;
+
+  if (dynamic) {
+    std::ios::sync_with_stdio(false);
+    graph.BuildReverse();
+    if (opts.dynamicFile == "-")
+      return RunDynamic(graph, std::cin) == -1 ? 1 : 0;
+
+    std::ifstream commands(opts.dynamicFile);
+    if (commands.fail()) {
+      std::cerr << "Error: cannot open file " << opts.dynamicFile
+                << std::endl;
+      return 1;
+    }
+    return RunDynamic(graph, commands) == -1 ? 1 : 0;
   }
+  if (fullSearch) {
+    std::ios::sync_with_stdio(false);
+    return RunFullSearch(graph, opts, index) == -1 ? 1 : 0;
+  }
+
+  if (!single) {
+    std::ios::sync_with_stdio(false);
+    ParallelQueryEngine engine(graph, opts.numThreads, opts.mode, index);
+    int status;
+    if (serve) {
+      status = RunServer(graph, engine, opts.numThreads, opts.serveSocket,
+                         ids);
+    } else if (opts.batchFile == "-") {
+      status = RunBatch(graph, std::cin, engine, ids, statsReport);
+    } else {
+      std::ifstream queries(opts.batchFile);
+      if (queries.fail()) {
+        std::cerr << "Error: cannot open file " << opts.batchFile
+                  << std::endl;
+        return 1;
+      }
+      status = RunBatch(graph, queries, engine, ids, statsReport);
+    }
+    if (index.treeCache)
+      PrintCacheStats(*index.treeCache);
+    if (statsReport)
+      statsReport->Finish();
+    return status == -1 ? 1 : 0;
+  }
+
+  int src = std::stoi(opts.positional[1]);
+  int dst = std::stoi(opts.positional[2]);
+  if (!CheckQuery(graph, src, dst))
+    return 1;
 
-  ShortestPath s(std::stoi(argv[2]), std::stoi(argv[3]));
+  std::vector<ShortestPath> paths(1, ShortestPath(src, dst));
+  if (opts.reorder)
+    paths[0].Renumber(ids.toInternal);
+  // Only delta-stepping has use for more threads on a single query
+  int numThreads = opts.mode == kDeltaStepping ? opts.numThreads : 1;
+  ParallelQueryEngine engine(graph, numThreads, opts.mode, index);
 
-  s.Dijkstra(graph);
+  engine.Run(paths);
+  if (opts.reorder)
+    paths[0].Renumber(ids.toExternal);
 
-  s.Print();
+  paths[0].Print();
+  if (statsReport) {
+    paths[0].ReportStats(*statsReport);
+    statsReport->Finish();
+  }
 
   return 0;
 }
@@ -0,0 +1,401 @@
+#ifndef SHORTEST_PATH_H_
+#define SHORTEST_PATH_H_
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "arc_flags.h"
+#include "compressed_graph.h"
+#include "contraction_hierarchy.h"
+#include "delta_stepping.h"
+#include "dijkstra.h"
+#include "dynamic_tree.h"
+#include "graph.h"
+#include "hub_labels.h"
+#include "index_min_pq.h"
+#include "search_stats.h"
+#include "tree_cache.h"
+
+// Shortest path query from a source to a destination vertex, answered by
+// any of the search engines
+class ShortestPath {
+ public:
+  ShortestPath(int sourceVertex, int destVertex);
+  void Dijkstra(const Graph &g);
+  template <typename Weight, typename Queue>
+  void Dijkstra(const BasicGraph<Weight> &g,
+                BasicDijkstraWorkspace<Queue> &ws);
+  template <typename Queue>
+  void Dijkstra(const CompressedGraph &g, BasicDijkstraWorkspace<Queue> &ws);
+  // Reads the path from the tree of the source in @cache. On a miss, grows
+  // the full tree with @ws and caches it first.
+  template <typename Weight, typename Queue>
+  void CachedDijkstra(const BasicGraph<Weight> &g, TreeCache &cache,
+                      BasicDijkstraWorkspace<Queue> &ws);
+  // Needs the reverse adjacency of @g
+  void BidirectionalDijkstra(const Graph &g, DijkstraWorkspace &fwd,
+                             DijkstraWorkspace &bwd);
+  // @bounds is a Landmarks or HubLabels index
+  template <typename Bounds>
+  void AStar(const Graph &g, const Bounds &bounds, DijkstraWorkspace &ws);
+  // Distance from the labels of @hl, path by A* on their exact distances
+  void HubLabelQuery(const Graph &g, const HubLabels &hl,
+                     DijkstraWorkspace &ws);
+  void HierarchyQuery(const ContractionHierarchy &ch, DijkstraWorkspace &fwd,
+                      DijkstraWorkspace &bwd);
+  // Dijkstra over the edges @af flags for the region of the destination
+  void ArcFlagDijkstra(const Graph &g, const ArcFlags &af,
+                       DijkstraWorkspace &ws);
+  // Full shortest path tree from the source by parallel delta-stepping
+  void DeltaSteppingSearch(DeltaStepping &ds);
+  // Reads the path from a tree maintained under updates, rooted at the
+  // source
+  void FromTree(const DynamicShortestPathTree &tree);
+  // Reads the path from the prev labels of a full search from the source
+  template <typename Labels>
+  void FromLabels(const Labels &labels);
+  // Answers all of @paths, which share their source, with one Dijkstra run
+  // that stops once every destination is settled
+  template <typename Queue>
+  static void MultiTargetDijkstra(const Graph &g,
+                                  std::vector<ShortestPath> &paths,
+                                  BasicDijkstraWorkspace<Queue> &ws);
+  // Replaces every vertex id u of the query and of the path by @ids[u]
+  void Renumber(const std::vector<unsigned int> &ids);
+  double GetDistance(void) const;
+  // Vertices of the path from the destination back to the source, empty if
+  // there is no path
+  const std::vector<int>& GetPath(void) const;
+  void Print(std::ostream &os = std::cout);
+  // Adds the counters and phase times of the last plain Dijkstra search to
+  // @report; they are all zero unless built with SEARCH_STATS
+  void ReportStats(StatsReport &report) const;
+
+ private:
+  // Read the path to the destination from the prev labels of @labels
+  template <typename Labels>
+  void ExtractPath(const Labels &labels);
+  // Relax @edges of @u in the search whose labels are in @ws, and keep the
+  // best meeting point with the opposite search @other
+  void ExpandBidirectional(EdgeRange edges, unsigned int u,
+                           DijkstraWorkspace &ws,
+                           const DijkstraWorkspace &other, double &best,
+                           int &meet);
+
+  int sourceVertex, destVertex;
+
+  std::vector<int> shortestPath;
+  double shortestDistance = std::numeric_limits<double>::max();
+  SearchStats stats;
+};
+
+inline ShortestPath::ShortestPath(int sourceVertex, int destVertex) :
+    sourceVertex(sourceVertex),  destVertex(destVertex) {}
+
+// Dijkstra's algorithm for finding shortest path in a graph
+inline void ShortestPath::Dijkstra(const Graph &g) {
+  DijkstraWorkspace ws(g.GetNumVertices());
+  Dijkstra(g, ws);
+}
+
+// Same as above, using (and overwriting) the scratch space of @ws and its
+// priority queue
+template <typename Weight, typename Queue>
+void ShortestPath::Dijkstra(const BasicGraph<Weight> &g,
+                            BasicDijkstraWorkspace<Queue> &ws) {
+  PhaseTimer timer;
+  RunDijkstra(g, sourceVertex, destVertex, false, ws);
+  double searchSeconds = timer.Lap();
+  ExtractPath(ws);
+  stats = ws.GetStats();
+  stats.searchSeconds = searchSeconds;
+  stats.unwindSeconds = timer.Lap();
+}
+
+template <typename Queue>
+void ShortestPath::Dijkstra(const CompressedGraph &g,
+                            BasicDijkstraWorkspace<Queue> &ws) {
+  RunDijkstra(g, sourceVertex, destVertex, ws);
+  ExtractPath(ws);
+}
+
+template <typename Weight, typename Queue>
+void ShortestPath::CachedDijkstra(const BasicGraph<Weight> &g,
+                                  TreeCache &cache,
+                                  BasicDijkstraWorkspace<Queue> &ws) {
+  std::shared_ptr<const ShortestPathTree> tree = cache.Find(sourceVertex);
+
+  if (!tree) {
+    RunDijkstra(g, sourceVertex, -1, false, ws);
+    tree = cache.Insert(sourceVertex, std::make_shared<ShortestPathTree>(
+        ws, g.GetNumVertices()));
+  }
+  ExtractPath(*tree);
+}
+
+// A* search using the lower bounds of @bounds as potentials: the queue is
+// keyed by dist(v) + LowerBound(v, dest). The bounds are consistent, so
+// the destination is final as soon as it is popped.
+template <typename Bounds>
+void ShortestPath::AStar(const Graph &g, const Bounds &bounds,
+                         DijkstraWorkspace &ws) {
+  IndexMinPQ<double> &Q = ws.GetQueue();
+
+  ws.NewQuery();
+  ws.Update(sourceVertex, 0, -1);
+
+  Q.Push(bounds.LowerBound(sourceVertex, destVertex), sourceVertex);
+
+  while (Q.Size()) {
+    int u = Q.Top();
+    Q.Pop();
+    ws.CountSettled();
+
+    if (u == destVertex) {
+      break;
+    }
+    double distU = ws.GetDist(u);
+    for (const Edge &e : g.GetEdges(u)) {
+      unsigned int v = e.GetEdgeDest();
+      double alt = distU + e.GetWeight();
+      if (alt < ws.GetDist(v)) {
+        ws.Update(v, alt, u);
+
+        double key = alt + bounds.LowerBound(v, destVertex);
+        if (Q.Contains(v))
+          Q.ChangeKey(key, v);
+        else
+          Q.Push(key, v);
+      }
+    }
+  }
+
+  ExtractPath(ws);
+}
+
+// With exact distances as potentials, A* only pops vertices of shortest
+// paths to the destination, and the path costs one label merge per edge
+// leaving them. Unreachable destinations are known without any search.
+inline void ShortestPath::HubLabelQuery(const Graph &g, const HubLabels &hl,
+                                        DijkstraWorkspace &ws) {
+  if (hl.Distance(sourceVertex, destVertex)
+      == std::numeric_limits<double>::max()) {
+    shortestPath.clear();
+    shortestDistance = std::numeric_limits<double>::max();
+    return;
+  }
+  AStar(g, hl, ws);
+}
+
+// Upward bidirectional search in the contraction hierarchy @ch, with the
+// shortcuts of the resulting path unpacked
+inline void ShortestPath::HierarchyQuery(const ContractionHierarchy &ch,
+                                         DijkstraWorkspace &fwd,
+                                         DijkstraWorkspace &bwd) {
+  shortestDistance = ch.Query(sourceVertex, destVertex, fwd, bwd,
+                              shortestPath);
+}
+
+inline void ShortestPath::ArcFlagDijkstra(const Graph &g, const ArcFlags &af,
+                                          DijkstraWorkspace &ws) {
+  IndexMinPQ<double> &Q = ws.GetQueue();
+  uint64_t bit = uint64_t(1) << af.GetRegion(destVertex);
+
+  ws.NewQuery();
+  ws.Update(sourceVertex, 0, -1);
+  Q.Push(0, sourceVertex);
+
+  while (Q.Size()) {
+    int u = Q.Top();
+    Q.Pop();
+    ws.CountSettled();
+
+    if (u == destVertex) {
+      break;
+    }
+    double distU = ws.GetDist(u);
+    const uint64_t *flags = af.GetFlags(u);
+    for (const Edge &e : g.GetEdges(u)) {
+      if (!(*flags++ & bit))
+        continue;
+      unsigned int v = e.GetEdgeDest();
+      double alt = distU + e.GetWeight();
+      if (alt < ws.GetDist(v)) {
+        ws.Update(v, alt, u);
+
+        if (Q.Contains(v))
+          Q.ChangeKey(alt, v);
+        else
+          Q.Push(alt, v);
+      }
+    }
+  }
+
+  ExtractPath(ws);
+}
+
+inline void ShortestPath::DeltaSteppingSearch(DeltaStepping &ds) {
+  ds.Run(sourceVertex);
+  ExtractPath(ds);
+}
+
+inline void ShortestPath::FromTree(const DynamicShortestPathTree &tree) {
+  ExtractPath(tree);
+}
+
+template <typename Labels>
+void ShortestPath::FromLabels(const Labels &labels) {
+  ExtractPath(labels);
+}
+
+template <typename Queue>
+void ShortestPath::MultiTargetDijkstra(const Graph &g,
+                                       std::vector<ShortestPath> &paths,
+                                       BasicDijkstraWorkspace<Queue> &ws) {
+  if (paths.empty())
+    return;
+
+  std::vector<unsigned int> targets;
+  for (const ShortestPath &path : paths)
+    targets.push_back(path.destVertex);
+  RunDijkstraToTargets(g, paths[0].sourceVertex, targets, ws);
+
+  for (ShortestPath &path : paths)
+    path.ExtractPath(ws);
+}
+
+template <typename Labels>
+void ShortestPath::ExtractPath(const Labels &labels) {
+  shortestPath.clear();
+  int u = destVertex;
+  if (labels.GetDist(u) != std::numeric_limits<double>::max()) {
+    while (u != -1) {
+      shortestPath.push_back(u);
+      u = labels.GetPrev(u);
+    }
+  }
+  shortestDistance = labels.GetDist(destVertex);
+}
+
+// Bidirectional Dijkstra: a forward search from the source and a backward
+// search from the destination on the reverse graph, always advancing the
+// side with the smaller queue minimum. Stops once the two minimums add up
+// to at least the best source to destination distance seen so far.
+inline void ShortestPath::BidirectionalDijkstra(const Graph &g,
+                                                DijkstraWorkspace &fwd,
+                                                DijkstraWorkspace &bwd) {
+  IndexMinPQ<double> &Qf = fwd.GetQueue();
+  IndexMinPQ<double> &Qb = bwd.GetQueue();
+  double best = std::numeric_limits<double>::max();
+  int meet = -1;
+
+  fwd.NewQuery();
+  bwd.NewQuery();
+  fwd.Update(sourceVertex, 0, -1);
+  bwd.Update(destVertex, 0, -1);
+  Qf.Push(0, sourceVertex);
+  Qb.Push(0, destVertex);
+
+  if (sourceVertex == destVertex) {
+    best = 0;
+    meet = sourceVertex;
+  }
+
+  while (Qf.Size() && Qb.Size()) {
+    double topF = fwd.GetDist(Qf.Top());
+    double topB = bwd.GetDist(Qb.Top());
+    if (topF + topB >= best)
+      break;
+
+    if (topF <= topB) {
+      unsigned int u = Qf.Top();
+      Qf.Pop();
+      fwd.CountSettled();
+      ExpandBidirectional(g.GetEdges(u), u, fwd, bwd, best, meet);
+    } else {
+      unsigned int u = Qb.Top();
+      Qb.Pop();
+      bwd.CountSettled();
+      ExpandBidirectional(g.GetReverseEdges(u), u, bwd, fwd, best, meet);
+    }
+  }
+
+  // Path is stored from destination to source: the backward labels lead
+  // from the meeting point to the destination, the forward ones back to
+  // the source
+  shortestPath.clear();
+  if (meet != -1) {
+    for (int u = bwd.GetPrev(meet); u != -1; u = bwd.GetPrev(u))
+      shortestPath.push_back(u);
+    std::reverse(shortestPath.begin(), shortestPath.end());
+    for (int u = meet; u != -1; u = fwd.GetPrev(u))
+      shortestPath.push_back(u);
+  }
+  shortestDistance = best;
+}
+
+inline void ShortestPath::ExpandBidirectional(EdgeRange edges, unsigned int u,
+                                              DijkstraWorkspace &ws,
+                                              const DijkstraWorkspace &other,
+                                              double &best, int &meet) {
+  IndexMinPQ<double> &Q = ws.GetQueue();
+  double distU = ws.GetDist(u);
+
+  for (const Edge &e : edges) {
+    unsigned int v = e.GetEdgeDest();
+    double alt = distU + e.GetWeight();
+    if (alt < ws.GetDist(v)) {
+      ws.Update(v, alt, u);
+
+      if (Q.Contains(v))
+        Q.ChangeKey(alt, v);
+      else
+        Q.Push(alt, v);
+
+      double otherDist = other.GetDist(v);
+      if (otherDist != std::numeric_limits<double>::max()
+          && alt + otherDist < best) {
+        best = alt + otherDist;
+        meet = v;
+      }
+    }
+  }
+}
+
+inline void ShortestPath::Renumber(const std::vector<unsigned int> &ids) {
+  sourceVertex = ids[sourceVertex];
+  destVertex = ids[destVertex];
+  for (int &u : shortestPath)
+    u = ids[u];
+}
+
+inline double ShortestPath::GetDistance(void) const {
+  return shortestDistance;
+}
+
+inline const std::vector<int>& ShortestPath::GetPath(void) const {
+  return shortestPath;
+}
+
+inline void ShortestPath::Print(std::ostream &os) {
+  os << sourceVertex << " to " << destVertex << ": ";
+  if (shortestPath.empty()) {
+    os << "no path" << '\n';
+    return;
+  }
+
+  for (auto i = shortestPath.size() - 1; i >= 1; i--) {
+    os << shortestPath.at(i) << " => ";
+  }
+  os << shortestPath.front() << " (";
+  os << shortestDistance << ')' << '\n';
+}
+
+inline void ShortestPath::ReportStats(StatsReport &report) const {
+  report.Add(sourceVertex, destVertex, stats);
+}
+
+#endif  // SHORTEST_PATH_H_
@@ -0,0 +1,238 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "query_server.h"
+
+// Sends all of @length bytes of @data to @fd
+// Returns -1 on error, 0 otherwise
+int SendAll(int fd, const char *data, size_t length) {
+  while (length) {
+    ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+    if (n < 0)
+      return -1;
+    data += n;
+    length -= n;
+  }
+  return 0;
+}
+
+// Buffered reads from the server
+class Reader {
+ public:
+  explicit Reader(int fd) : fd(fd) {}
+  // Reads exactly @length bytes into @data
+  // Returns -1 if the server closed the connection first, 0 otherwise
+  int Read(char *data, size_t length);
+  // Reads up to and including the next newline into @line
+  int ReadLine(std::string &line);
+
+ private:
+  // Returns false once the server closed the connection
+  bool Fill(void);
+
+  int fd;
+  std::vector<char> buffer = std::vector<char>(64 << 10);
+  size_t pos = 0, size = 0;
+};
+
+bool Reader::Fill(void) {
+  ssize_t n = read(fd, buffer.data(), buffer.size());
+  pos = 0;
+  size = std::max<ssize_t>(n, 0);
+  return n > 0;
+}
+
+int Reader::Read(char *data, size_t length) {
+  while (length) {
+    if (pos == size && !Fill())
+      return -1;
+    size_t n = std::min(length, size - pos);
+    std::memcpy(data, buffer.data() + pos, n);
+    pos += n;
+    data += n;
+    length -= n;
+  }
+  return 0;
+}
+
+int Reader::ReadLine(std::string &line) {
+  line.clear();
+  for (;;) {
+    if (pos == size && !Fill())
+      return -1;
+    const char *start = buffer.data() + pos;
+    const char *newline = static_cast<const char *>(
+        std::memchr(start, '\n', size - pos));
+    size_t n = newline ? newline - start + 1 : size - pos;
+    line.append(start, n);
+    pos += n;
+    if (newline)
+      return 0;
+  }
+}
+
+// Sends query @i, binary or as its text line
+int SendQuery(int fd, bool binary, const std::vector<std::string> &lines,
+              const std::vector<QueryRequest> &requests, size_t i) {
+  if (binary) {
+    return SendAll(fd, reinterpret_cast<const char *>(&requests[i]),
+                   sizeof(QueryRequest));
+  }
+  return SendAll(fd, lines[i].data(), lines[i].size());
+}
+
+// Reads the answer to @request and prints it in the text format
+// Returns -1 if the server closed the connection, 0 otherwise
+int ReceiveAnswer(Reader &reader, bool binary, const QueryRequest &request) {
+  if (!binary) {
+    std::string line;
+    if (reader.ReadLine(line) == -1)
+      return -1;
+    std::cout << line;
+    return 0;
+  }
+
+  QueryAnswer answer;
+  if (reader.Read(reinterpret_cast<char *>(&answer), sizeof(answer)) == -1)
+    return -1;
+  std::vector<uint32_t> path(answer.numVertices);
+  if (reader.Read(reinterpret_cast<char *>(path.data()),
+                  path.size() * sizeof(uint32_t)) == -1)
+    return -1;
+
+  if (answer.status == kQueryInvalid) {
+    std::cout << "Error: invalid query\n";
+    return 0;
+  }
+  std::cout << request.src << " to " << request.dst << ": ";
+  if (answer.status == kQueryNoPath) {
+    std::cout << "no path\n";
+    return 0;
+  }
+  for (size_t i = 0; i + 1 < path.size(); i++)
+    std::cout << path[i] << " => ";
+  std::cout << path.back() << " (" << answer.distance << ")\n";
+  return 0;
+}
+
+void PrintUsage(const char *prog) {
+  std::cerr << "Usage: " << prog << " <socket> [--binary] [--latency]"
+            << " < queries" << std::endl;
+}
+
+// Sends the "src dst" lines of standard input to a shortest_path --serve
+// server and prints the answers in order. Queries are pipelined, or with
+// --latency sent one at a time, timing each.
+int main(int argc, char *argv[]) {
+  std::string socketPath;
+  bool binary = false;
+  bool latency = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--binary")
+      binary = true;
+    else if (arg == "--latency")
+      latency = true;
+    else if (socketPath.empty() && arg.compare(0, 2, "--") != 0)
+      socketPath = arg;
+    else
+      socketPath = "--";  // Rejected below
+  }
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketPath.empty() || socketPath == "--"
+      || socketPath.size() >= sizeof(addr.sun_path)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size());
+
+  // Blank lines get no answer; binary requests need parsed vertices, and
+  // lines that do not parse are sent as vertices no graph has
+  std::vector<std::string> lines;
+  std::vector<QueryRequest> requests;
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+    std::istringstream ss(line);
+    long long src, dst;
+    QueryRequest request;
+    bool valid = static_cast<bool>(ss >> src >> dst) && src >= 0 && dst >= 0
+        && src <= UINT32_MAX && dst <= UINT32_MAX;
+    request.src = valid ? src : UINT32_MAX;
+    request.dst = valid ? dst : UINT32_MAX;
+    requests.push_back(request);
+    lines.push_back(line + '\n');
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                        sizeof(addr)) < 0) {
+    std::cerr << "Error: cannot connect to " << socketPath << std::endl;
+    return 1;
+  }
+  if (binary && SendAll(fd, kQueryBinaryMagic, sizeof(kQueryBinaryMagic))) {
+    std::cerr << "Error: cannot send to " << socketPath << std::endl;
+    return 1;
+  }
+
+  std::ios::sync_with_stdio(false);
+  Reader reader(fd);
+  size_t n = requests.size();
+  int status = 0;
+
+  if (latency) {
+    std::vector<double> millis;
+    for (size_t i = 0; i < n && status == 0; i++) {
+      auto start = std::chrono::steady_clock::now();
+      status = SendQuery(fd, binary, lines, requests, i);
+      if (status == 0)
+        status = ReceiveAnswer(reader, binary, requests[i]);
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      millis.push_back(elapsed.count());
+    }
+    if (!millis.empty()) {
+      std::sort(millis.begin(), millis.end());
+      std::cerr << millis.size() << " queries, p50 "
+                << millis[millis.size() / 2] << " ms, p99 "
+                << millis[millis.size() * 99 / 100] << " ms, max "
+                << millis.back() << " ms" << std::endl;
+    }
+  } else {
+    // The answers are read while the queries are still being sent, or
+    // both sides could block on full socket buffers
+    int sendStatus = 0;
+    std::thread sender([&] {
+      for (size_t i = 0; i < n && sendStatus == 0; i++)
+        sendStatus = SendQuery(fd, binary, lines, requests, i);
+      shutdown(fd, SHUT_WR);
+    });
+    for (size_t i = 0; i < n && status == 0; i++)
+      status = ReceiveAnswer(reader, binary, requests[i]);
+    sender.join();
+    if (sendStatus)
+      status = -1;
+  }
+
+  close(fd);
+  if (status) {
+    std::cerr << "Error: connection to " << socketPath << " lost"
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
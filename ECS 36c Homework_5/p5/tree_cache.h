@@ -0,0 +1,140 @@
+#ifndef TREE_CACHE_H_
+#define TREE_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Completed shortest path tree from one source: the dist and prev labels
+// of every vertex, readable like a Dijkstra workspace
+class ShortestPathTree {
+ public:
+  // Copies the labels of a finished full search
+  template <typename Labels>
+  ShortestPathTree(const Labels &labels, int numVertices);
+  double GetDist(unsigned int v) const { return dist[v]; }
+  int GetPrev(unsigned int v) const { return prev[v]; }
+  // Memory the tree holds
+  size_t GetNumBytes(void) const;
+
+ private:
+  std::vector<double> dist;
+  std::vector<int> prev;
+};
+
+// Least recently used cache of shortest path trees by source, under a
+// memory budget. Safe to share between threads; a tree handed out stays
+// valid after it is evicted, until its last user drops it.
+class TreeCache {
+ public:
+  explicit TreeCache(size_t budgetBytes);
+  // Returns the tree of @source, nullptr if it is not cached. Counts a
+  // hit or a miss.
+  std::shared_ptr<const ShortestPathTree> Find(unsigned int source);
+  // Caches @tree as the tree of @source, evicting the least recently used
+  // trees to stay within the budget. Returns the cached tree, which is an
+  // earlier one if another thread inserted @source first.
+  std::shared_ptr<const ShortestPathTree> Insert(
+      unsigned int source, std::shared_ptr<const ShortestPathTree> tree);
+
+  uint64_t GetNumHits(void) const;
+  uint64_t GetNumMisses(void) const;
+  uint64_t GetNumEvictions(void) const;
+  size_t GetNumTrees(void) const;
+  size_t GetNumBytes(void) const;
+
+ private:
+  typedef std::pair<unsigned int, std::shared_ptr<const ShortestPathTree>>
+      Entry;
+
+  size_t budgetBytes;
+  size_t numBytes = 0;
+  uint64_t numHits = 0, numMisses = 0, numEvictions = 0;
+  // Most recently used first
+  std::list<Entry> entries;
+  std::unordered_map<unsigned int, std::list<Entry>::iterator> bySource;
+  mutable std::mutex mutex;
+};
+
+template <typename Labels>
+ShortestPathTree::ShortestPathTree(const Labels &labels, int numVertices)
+    : dist(numVertices), prev(numVertices) {
+  for (int v = 0; v < numVertices; v++) {
+    dist[v] = labels.GetDist(v);
+    prev[v] = labels.GetPrev(v);
+  }
+}
+
+inline size_t ShortestPathTree::GetNumBytes(void) const {
+  return sizeof(*this) + dist.size() * sizeof(double)
+      + prev.size() * sizeof(int);
+}
+
+inline TreeCache::TreeCache(size_t budgetBytes) : budgetBytes(budgetBytes) {}
+
+inline std::shared_ptr<const ShortestPathTree> TreeCache::Find(
+    unsigned int source) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = bySource.find(source);
+  if (it == bySource.end()) {
+    numMisses++;
+    return nullptr;
+  }
+  numHits++;
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->second;
+}
+
+inline std::shared_ptr<const ShortestPathTree> TreeCache::Insert(
+    unsigned int source, std::shared_ptr<const ShortestPathTree> tree) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = bySource.find(source);
+  if (it != bySource.end())
+    return it->second->second;
+  if (tree->GetNumBytes() > budgetBytes)
+    return tree;  // Could never be cached
+
+  numBytes += tree->GetNumBytes();
+  entries.push_front(Entry(source, tree));
+  bySource[source] = entries.begin();
+  while (numBytes > budgetBytes) {
+    numBytes -= entries.back().second->GetNumBytes();
+    bySource.erase(entries.back().first);
+    entries.pop_back();
+    numEvictions++;
+  }
+  return tree;
+}
+
+inline uint64_t TreeCache::GetNumHits(void) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return numHits;
+}
+
+inline uint64_t TreeCache::GetNumMisses(void) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return numMisses;
+}
+
+inline uint64_t TreeCache::GetNumEvictions(void) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return numEvictions;
+}
+
+inline size_t TreeCache::GetNumTrees(void) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+inline size_t TreeCache::GetNumBytes(void) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return numBytes;
+}
+
+#endif  // TREE_CACHE_H_